@@ -15,6 +15,11 @@ class diagonal_view{
         // constructor
         diagonal_view(const matrix<T, order>& m): mat(m) {}
 
+        // Get the underlying matrix
+        const matrix<T, order>& get_matrix() const{
+            return mat;
+        }
+
         // Function to get the diagonal elements
         T operator()(std::size_t i) const{
             // Check if the index is within bounds
@@ -0,0 +1,667 @@
+#ifndef EXPRESSION_HPP
+#define EXPRESSION_HPP
+
+#include "matrix.hpp"
+#include "transpose_view.hpp"
+#include "diagonal_view.hpp"
+#include <algorithm>
+#include <concepts>
+
+// Lazy vector expressions over matrices, views and vectors.
+// Expressions are built with lazy() and the usual operators, nothing is computed until
+// the expression is assigned with assign() or add_assign(). When every term can be
+// computed row by row (vectors, compressed row-major products, transposed compressed
+// column-major products) the whole expression is evaluated in a single fused loop,
+// otherwise the row-wise terms are assigned first and the remaining terms are scattered
+// into the output. A diagonal applied to scattered terms scales every entry as it is
+// scattered. Assigning into a vector of the right size allocates nothing unless the
+// output vector is also an operand that would be overwritten before being read, in which
+// case the expression is evaluated into a temporary.
+
+namespace algebra {
+
+// Base class of all vector expressions
+template<typename E>
+class vector_expression{
+    public:
+    // Get the derived expression
+    const E& derived() const{
+        return static_cast<const E&>(*this);
+    }
+
+    // Evaluate the expression into a new vector
+    auto eval() const{
+        std::vector<typename E::value_type> out(derived().size());
+        derived().assign_to(out, typename E::value_type(1));
+        return out;
+    }
+
+    // Conversion to std::vector
+    template<typename V>
+    operator std::vector<V>() const{
+        std::vector<V> out(derived().size());
+        derived().assign_to(out, V(1));
+        return out;
+    }
+};
+
+// Concept satisfied by vector expressions
+template<typename E>
+concept is_vector_expression = std::is_base_of_v<vector_expression<E>, E>;
+
+// Concept satisfied by scalars
+template<typename S>
+concept is_scalar = is_arithmetic_or_complex<S>::value;
+
+// Row scaling of add_to() leaving the values unchanged
+struct no_scaling{
+    template<typename V>
+    V operator()(std::size_t, V v) const{
+        return v;
+    }
+};
+
+// Leaf expression referring to an existing vector
+template<typename T>
+class vector_ref: public vector_expression<vector_ref<T>>{
+    private:
+    const std::vector<T>& vec;
+
+    public:
+    using value_type = T;
+
+    // Constructor
+    vector_ref(const std::vector<T>& v): vec(v) {}
+
+    // Get the referred vector
+    const std::vector<T>& get_vector() const{
+        return vec;
+    }
+
+    std::size_t size() const{
+        return vec.size();
+    }
+
+    bool indexable() const{
+        return true;
+    }
+
+    T value(std::size_t i) const{
+        return vec[i];
+    }
+
+    // Check if the expression reads the vector at address p
+    bool reads(const void* p) const{
+        return p == &vec;
+    }
+
+    // Elementwise reads of the output are always safe
+    bool safe_assign(const void*) const{
+        return true;
+    }
+
+    bool safe_add(const void*) const{
+        return true;
+    }
+
+    template<typename V, typename S>
+    void assign_to(std::vector<V>& out, S alpha) const{
+        for (std::size_t i = 0; i < out.size(); ++i){
+            out[i] = alpha * vec[i];
+        }
+    }
+
+    // Add the expression to out, scale(i, v) scales the value v of row i
+    template<typename V, typename S, typename F = no_scaling>
+    void add_to(std::vector<V>& out, S alpha, F scale = {}) const{
+        for (std::size_t i = 0; i < out.size(); ++i){
+            out[i] += scale(i, alpha * vec[i]);
+        }
+    }
+};
+
+// Scalar times expression
+template<typename S, typename E>
+class scaled_expr: public vector_expression<scaled_expr<S, E>>{
+    private:
+    S scalar;
+    E expr;
+
+    public:
+    using value_type = std::common_type_t<S, typename E::value_type>;
+
+    // Constructor
+    scaled_expr(S s, const E& e): scalar(s), expr(e) {}
+
+    std::size_t size() const{
+        return expr.size();
+    }
+
+    bool indexable() const{
+        return expr.indexable();
+    }
+
+    value_type value(std::size_t i) const{
+        return scalar * expr.value(i);
+    }
+
+    bool reads(const void* p) const{
+        return expr.reads(p);
+    }
+
+    bool safe_assign(const void* p) const{
+        return expr.safe_assign(p);
+    }
+
+    bool safe_add(const void* p) const{
+        return expr.safe_add(p);
+    }
+
+    // The scalar is folded into the coefficient of the inner expression
+    template<typename V, typename S2>
+    void assign_to(std::vector<V>& out, S2 alpha) const{
+        expr.assign_to(out, alpha * scalar);
+    }
+
+    template<typename V, typename S2, typename F = no_scaling>
+    void add_to(std::vector<V>& out, S2 alpha, F scale = {}) const{
+        expr.add_to(out, alpha * scalar, scale);
+    }
+};
+
+// Sum or difference of two expressions
+template<typename L, typename R>
+class sum_expr: public vector_expression<sum_expr<L, R>>{
+    private:
+    L lhs;
+    R rhs;
+    bool subtract;  // Compute lhs - rhs instead of lhs + rhs
+
+    public:
+    using value_type = std::common_type_t<typename L::value_type, typename R::value_type>;
+
+    // Constructor
+    sum_expr(const L& l, const R& r, bool sub): lhs(l), rhs(r), subtract(sub) {
+        if (lhs.size() != rhs.size()){
+            throw std::invalid_argument("Vector dimensions do not match");
+        }
+    }
+
+    std::size_t size() const{
+        return lhs.size();
+    }
+
+    bool indexable() const{
+        return lhs.indexable() && rhs.indexable();
+    }
+
+    value_type value(std::size_t i) const{
+        return subtract ? lhs.value(i) - rhs.value(i) : lhs.value(i) + rhs.value(i);
+    }
+
+    bool reads(const void* p) const{
+        return lhs.reads(p) || rhs.reads(p);
+    }
+
+    // The operand computed row by row is assigned first, the other one is added after it
+    bool safe_assign(const void* p) const{
+        if (indexable()){
+            return lhs.safe_assign(p) && rhs.safe_assign(p);
+        }
+        if (!lhs.indexable() && rhs.indexable()){
+            return rhs.safe_assign(p) && !lhs.reads(p);
+        }
+        return lhs.safe_assign(p) && !rhs.reads(p);
+    }
+
+    bool safe_add(const void* p) const{
+        if (indexable()){
+            return lhs.safe_add(p) && rhs.safe_add(p);
+        }
+        return lhs.safe_add(p) && !rhs.reads(p);
+    }
+
+    template<typename V, typename S>
+    void assign_to(std::vector<V>& out, S alpha) const{
+        if (indexable()){
+            // Single fused loop
+            for (std::size_t i = 0; i < out.size(); ++i){
+                out[i] = alpha * value(i);
+            }
+            return;
+        }
+        S beta = subtract ? -alpha : alpha;
+        if (!lhs.indexable() && rhs.indexable()){
+            rhs.assign_to(out, beta);
+            lhs.add_to(out, alpha);
+        }
+        else{
+            lhs.assign_to(out, alpha);
+            rhs.add_to(out, beta);
+        }
+    }
+
+    template<typename V, typename S, typename F = no_scaling>
+    void add_to(std::vector<V>& out, S alpha, F scale = {}) const{
+        if (indexable()){
+            // Single fused loop
+            for (std::size_t i = 0; i < out.size(); ++i){
+                out[i] += scale(i, alpha * value(i));
+            }
+            return;
+        }
+        lhs.add_to(out, alpha, scale);
+        rhs.add_to(out, subtract ? -alpha : alpha, scale);
+    }
+};
+
+// Lazy operand referring to a matrix or to the transpose of a matrix
+template<typename T, StorageOrder order, bool transposed>
+class sparse_operand{
+    private:
+    const matrix<T, order>& mat;
+
+    public:
+    // Constructor
+    sparse_operand(const matrix<T, order>& m): mat(m) {}
+
+    // Get the underlying matrix
+    const matrix<T, order>& get_matrix() const{
+        return mat;
+    }
+
+    std::size_t get_rows() const{
+        return transposed ? mat.get_cols() : mat.get_rows();
+    }
+
+    std::size_t get_cols() const{
+        return transposed ? mat.get_rows() : mat.get_cols();
+    }
+
+    // Rows of the operand are contiguous in the compressed vectors
+    bool row_contiguous() const{
+        return mat.is_compressed() && ((order == StorageOrder::row_major) != transposed);
+    }
+};
+
+// Product of a matrix or transposed matrix with a vector
+template<typename T, StorageOrder order, bool transposed, typename T2>
+class sparse_product: public vector_expression<sparse_product<T, order, transposed, T2>>{
+    private:
+    sparse_operand<T, order, transposed> op;
+    vector_ref<T2> vec;
+
+    public:
+    using value_type = std::common_type_t<T, T2>;
+
+    // Constructor
+    sparse_product(const sparse_operand<T, order, transposed>& o, const vector_ref<T2>& v): op(o), vec(v) {
+        if (op.get_cols() != vec.size()){
+            throw std::invalid_argument("Matrix and vector dimensions do not match");
+        }
+    }
+
+    std::size_t size() const{
+        return op.get_rows();
+    }
+
+    bool indexable() const{
+        return op.row_contiguous();
+    }
+
+    // Dot product of row i with the vector, only valid when indexable
+    value_type value(std::size_t i) const{
+        const auto& outer_start = op.get_matrix().get_outer_start();
+        const auto& inner_indices = op.get_matrix().get_inner_indices();
+        const auto& values = op.get_matrix().get_values();
+        const auto& x = vec.get_vector();
+        value_type sum = value_type{};
+        for (std::size_t idx = outer_start[i]; idx < outer_start[i + 1]; ++idx){
+            sum += static_cast<value_type>(values[idx]) * x[inner_indices[idx]];
+        }
+        return sum;
+    }
+
+    // Dot product of row i with the vector, the diagonal element (i, i) met during the
+    // scan is stored in diagonal, which is left unchanged if the row has none
+    value_type value(std::size_t i, T& diagonal) const{
+        const auto& outer_start = op.get_matrix().get_outer_start();
+        const auto& inner_indices = op.get_matrix().get_inner_indices();
+        const auto& values = op.get_matrix().get_values();
+        const auto& x = vec.get_vector();
+        value_type sum = value_type{};
+        for (std::size_t idx = outer_start[i]; idx < outer_start[i + 1]; ++idx){
+            std::size_t j = inner_indices[idx];
+            if (j == i){
+                diagonal = values[idx];
+            }
+            sum += static_cast<value_type>(values[idx]) * x[j];
+        }
+        return sum;
+    }
+
+    // Check if the operand is the matrix at address m, transposed or not
+    bool refers_to(const void* m) const{
+        return &op.get_matrix() == m;
+    }
+
+    bool reads(const void* p) const{
+        return vec.reads(p);
+    }
+
+    // Rows read other entries of the vector, so the output cannot be the vector itself
+    bool safe_assign(const void* p) const{
+        return !vec.reads(p);
+    }
+
+    bool safe_add(const void* p) const{
+        return !vec.reads(p);
+    }
+
+    template<typename V, typename S>
+    void assign_to(std::vector<V>& out, S alpha) const{
+        if (indexable()){
+            for (std::size_t i = 0; i < out.size(); ++i){
+                out[i] = alpha * value(i);
+            }
+            return;
+        }
+        std::fill(out.begin(), out.end(), V{});
+        scatter(out, alpha, no_scaling{});
+    }
+
+    template<typename V, typename S, typename F = no_scaling>
+    void add_to(std::vector<V>& out, S alpha, F scale = {}) const{
+        if (indexable()){
+            for (std::size_t i = 0; i < out.size(); ++i){
+                out[i] += scale(i, alpha * value(i));
+            }
+            return;
+        }
+        scatter(out, alpha, scale);
+    }
+
+    // Accumulate alpha * op * vec into out, column by column of the operand,
+    // every entry is scaled by scale(row, entry) as it is added
+    template<typename V, typename S, typename F>
+    void scatter(std::vector<V>& out, S alpha, F scale) const{
+        const matrix<T, order>& mat = op.get_matrix();
+        const auto& x = vec.get_vector();
+
+        // matrix is not compressed
+        if (!mat.is_compressed()){
+            for (const auto& [key, value]: mat.get_data()){
+                std::size_t row = transposed ? key[1] : key[0];
+                std::size_t col = transposed ? key[0] : key[1];
+                out[row] += scale(row, alpha * (static_cast<value_type>(value) * x[col]));
+            }
+            return;
+        }
+
+        // matrix is compressed, outer index is a column of the operand
+        const auto& outer_start = mat.get_outer_start();
+        const auto& inner_indices = mat.get_inner_indices();
+        const auto& values = mat.get_values();
+        for (std::size_t j = 0; j + 1 < outer_start.size(); ++j){
+            auto xj = alpha * static_cast<value_type>(x[j]);
+            for (std::size_t idx = outer_start[j]; idx < outer_start[j + 1]; ++idx){
+                out[inner_indices[idx]] += scale(inner_indices[idx], static_cast<value_type>(values[idx]) * xj);
+            }
+        }
+    }
+};
+
+// Lazy operand referring to the diagonal of a matrix or to its inverse.
+// The diagonal elements are read from the matrix when the expression is evaluated,
+// so the operand stores nothing and always sees the current values of the matrix.
+template<typename T, StorageOrder order>
+class diagonal_operand{
+    private:
+    const matrix<T, order>& mat;
+    bool inverted;
+
+    public:
+    // Constructor
+    diagonal_operand(const matrix<T, order>& m, bool inv = false): mat(m), inverted(inv) {}
+
+    // Get the underlying matrix
+    const matrix<T, order>& get_matrix() const{
+        return mat;
+    }
+
+    // Inverse of the diagonal
+    diagonal_operand inverse() const{
+        return diagonal_operand(mat, !inverted);
+    }
+
+    std::size_t size() const{
+        return std::min(mat.get_rows(), mat.get_cols());
+    }
+
+    // Get the i-th diagonal element, without the bounds checks of operator()
+    T element(std::size_t i) const{
+        // matrix is not compressed
+        if (!mat.is_compressed()){
+            auto it = mat.get_data().find({i, i});
+            return it == mat.get_data().end() ? T() : it->second;
+        }
+        // Element (i, i) has inner index i in outer index i, found by binary search
+        const auto& outer_start = mat.get_outer_start();
+        const auto& inner_indices = mat.get_inner_indices();
+        auto first = inner_indices.begin() + outer_start[i];
+        auto last = inner_indices.begin() + outer_start[i + 1];
+        auto it = std::lower_bound(first, last, i);
+        return (it != last && *it == i) ? mat.get_values()[it - inner_indices.begin()] : T();
+    }
+
+    // Multiply v by the diagonal element d or by its inverse
+    template<typename V>
+    auto apply_element(T d, V v) const{
+        return inverted ? v / d : v * d;
+    }
+
+    // Multiply v by the i-th diagonal element or by its inverse
+    template<typename V>
+    auto apply(std::size_t i, V v) const{
+        return apply_element(element(i), v);
+    }
+};
+
+// Concept satisfied by products that can read the diagonal element of a row of matrix<T>
+// during the scan computing that row
+template<typename E, typename T>
+concept diagonal_scan = requires(const E& e, std::size_t i, T& d, const void* m){
+    e.value(i, d);
+    { e.refers_to(m) } -> std::convertible_to<bool>;
+};
+
+// Product of a diagonal with an expression
+template<typename T, StorageOrder order, typename E>
+class diagonal_product: public vector_expression<diagonal_product<T, order, E>>{
+    private:
+    diagonal_operand<T, order> diag;
+    E expr;
+
+    public:
+    using value_type = std::common_type_t<T, typename E::value_type>;
+
+    // Constructor
+    diagonal_product(const diagonal_operand<T, order>& d, const E& e): diag(d), expr(e) {
+        if (diag.size() != expr.size()){
+            throw std::invalid_argument("Diagonal and vector dimensions do not match");
+        }
+    }
+
+    std::size_t size() const{
+        return expr.size();
+    }
+
+    bool indexable() const{
+        return expr.indexable();
+    }
+
+    value_type value(std::size_t i) const{
+        // A product with the same matrix finds the diagonal element in the same row scan
+        if constexpr (diagonal_scan<E, T>){
+            if (expr.refers_to(&diag.get_matrix())){
+                T d = T();
+                value_type v = expr.value(i, d);
+                return diag.apply_element(d, v);
+            }
+        }
+        return diag.apply(i, static_cast<value_type>(expr.value(i)));
+    }
+
+    bool reads(const void* p) const{
+        return expr.reads(p);
+    }
+
+    bool safe_assign(const void* p) const{
+        return expr.safe_assign(p);
+    }
+
+    bool safe_add(const void* p) const{
+        return expr.safe_add(p);
+    }
+
+    template<typename V, typename S>
+    void assign_to(std::vector<V>& out, S alpha) const{
+        if (indexable()){
+            for (std::size_t i = 0; i < out.size(); ++i){
+                out[i] = alpha * value(i);
+            }
+            return;
+        }
+        // Evaluate the inner expression in place, then scale by the diagonal
+        expr.assign_to(out, alpha);
+        for (std::size_t i = 0; i < out.size(); ++i){
+            out[i] = diag.apply(i, out[i]);
+        }
+    }
+
+    template<typename V, typename S, typename F = no_scaling>
+    void add_to(std::vector<V>& out, S alpha, F scale = {}) const{
+        if (indexable()){
+            for (std::size_t i = 0; i < out.size(); ++i){
+                out[i] += scale(i, alpha * value(i));
+            }
+            return;
+        }
+        // Every entry of the inner expression is scaled by the diagonal as it is added
+        expr.add_to(out, alpha, [this, &scale](std::size_t i, auto v){ return scale(i, diag.apply(i, v)); });
+    }
+};
+
+// Create lazy operands
+template<typename T>
+vector_ref<T> lazy(const std::vector<T>& v){
+    return vector_ref<T>(v);
+}
+
+template<typename T, StorageOrder order>
+sparse_operand<T, order, false> lazy(const matrix<T, order>& m){
+    return sparse_operand<T, order, false>(m);
+}
+
+template<typename T, StorageOrder order>
+sparse_operand<T, order, true> lazy(const transpose_view<T, order>& t){
+    return sparse_operand<T, order, true>(t.get_matrix());
+}
+
+template<typename T, StorageOrder order>
+diagonal_operand<T, order> lazy(const diagonal_view<T, order>& d){
+    return diagonal_operand<T, order>(d.get_matrix());
+}
+
+// Temporaries would be destroyed before the expression is evaluated
+template<typename T>
+void lazy(const std::vector<T>&&) = delete;
+
+template<typename T, StorageOrder order>
+void lazy(const matrix<T, order>&&) = delete;
+
+// Inverse of a lazy diagonal
+template<typename T, StorageOrder order>
+diagonal_operand<T, order> inverse(const diagonal_operand<T, order>& d){
+    return d.inverse();
+}
+
+// Operators building the expressions
+template<typename T, StorageOrder order, bool transposed, typename T2>
+sparse_product<T, order, transposed, T2> operator*(const sparse_operand<T, order, transposed>& op, const vector_ref<T2>& v){
+    return sparse_product<T, order, transposed, T2>(op, v);
+}
+
+template<typename T, StorageOrder order, typename E>
+requires is_vector_expression<E>
+diagonal_product<T, order, E> operator*(const diagonal_operand<T, order>& d, const E& e){
+    return diagonal_product<T, order, E>(d, e);
+}
+
+template<typename S, typename E>
+requires is_scalar<S> && is_vector_expression<E>
+scaled_expr<S, E> operator*(S s, const E& e){
+    return scaled_expr<S, E>(s, e);
+}
+
+template<typename S, typename E>
+requires is_scalar<S> && is_vector_expression<E>
+scaled_expr<S, E> operator*(const E& e, S s){
+    return scaled_expr<S, E>(s, e);
+}
+
+template<typename E>
+requires is_vector_expression<E>
+scaled_expr<typename E::value_type, E> operator-(const E& e){
+    return scaled_expr<typename E::value_type, E>(typename E::value_type(-1), e);
+}
+
+template<typename L, typename R>
+requires is_vector_expression<L> && is_vector_expression<R>
+sum_expr<L, R> operator+(const L& l, const R& r){
+    return sum_expr<L, R>(l, r, false);
+}
+
+template<typename L, typename R>
+requires is_vector_expression<L> && is_vector_expression<R>
+sum_expr<L, R> operator-(const L& l, const R& r){
+    return sum_expr<L, R>(l, r, true);
+}
+
+// Evaluate out = expr
+template<typename V, typename E>
+requires is_vector_expression<E>
+void assign(std::vector<V>& out, const E& expr){
+    // The output is also an operand that would be overwritten before being read
+    if (!expr.safe_assign(&out)){
+        std::vector<V> tmp(expr.size());
+        expr.assign_to(tmp, V(1));
+        out = std::move(tmp);
+        return;
+    }
+    out.resize(expr.size());
+    expr.assign_to(out, V(1));
+}
+
+// Evaluate out += expr
+template<typename V, typename E>
+requires is_vector_expression<E>
+void add_assign(std::vector<V>& out, const E& expr){
+    if (out.size() != expr.size()){
+        throw std::invalid_argument("Vector dimensions do not match");
+    }
+    // The output is also an operand that would be overwritten before being read
+    if (!expr.safe_add(&out)){
+        std::vector<V> tmp(expr.size());
+        expr.assign_to(tmp, V(1));
+        for (std::size_t i = 0; i < out.size(); ++i){
+            out[i] += tmp[i];
+        }
+        return;
+    }
+    expr.add_to(out, V(1));
+}
+
+}
+
+#endif
@@ -10,6 +10,7 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <span>
 
 //namespace algebra
 namespace algebra {
@@ -111,7 +112,7 @@ class matrix{
 
     // Get the number of non-zero elements
     std::size_t get_nnz() const {
-        return data.size();
+        return compressed ? values.size() : data.size();
     }
 
 
@@ -321,6 +322,46 @@ class matrix{
         return compressed; 
     }
 
+    // Get the uncompressed data (empty when compressed)
+    const auto& get_data() const{
+        return data;
+    }
+
+    // Get the compressed values vector (empty when uncompressed)
+    const std::vector<T>& get_values() const{
+        return values;
+    }
+
+    // Get the compressed inner indices vector (empty when uncompressed)
+    const std::vector<std::size_t>& get_inner_indices() const{
+        return inner_indices;
+    }
+
+    // Get the compressed outer start vector (empty when uncompressed)
+    const std::vector<std::size_t>& get_outer_start() const{
+        return outer_start;
+    }
+
+    // Get the compressed values for modification, the sparsity pattern cannot change
+    std::span<T> get_values_mutable(){
+        return std::span<T>(values);
+    }
+
+    // Replace the content of the matrix with already compressed vectors
+    void set_compressed(std::size_t r, std::size_t c, std::vector<std::size_t> outer, std::vector<std::size_t> inner, std::vector<T> vals){
+        // Check the sizes of the compression vectors
+        if (outer.size() != (order == StorageOrder::row_major ? r : c) + 1 || inner.size() != vals.size() || outer.back() != vals.size()){
+            throw std::invalid_argument("Compression vectors do not match the matrix dimensions");
+        }
+        data.clear();
+        rows = r;
+        cols = c;
+        outer_start = std::move(outer);
+        inner_indices = std::move(inner);
+        values = std::move(vals);
+        compressed = true;
+    }
+
     // call operator const version
     T operator() (std::size_t i, std::size_t j) const{
         // Check indices
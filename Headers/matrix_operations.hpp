@@ -0,0 +1,262 @@
+#ifndef MATRIX_OPERATIONS_HPP
+#define MATRIX_OPERATIONS_HPP
+
+#include "matrix.hpp"
+#include "parallel.hpp"
+#include <type_traits>
+
+// Element-wise operations on compressed matrices of the same storage order.
+// Results are built with a two-pass row-wise sorted merge of the compressed vectors:
+// a symbolic pass counts the entries of every row (column for column-major matrices),
+// a numeric pass writes them at the offsets given by the cumulative sum of the counts.
+// Both passes are parallelized over rows. The sparsity pattern of a result is structural,
+// entries that cancel out (e.g. A - A) are kept as explicit zeros.
+
+namespace algebra {
+
+// Check that two matrices can be combined element-wise
+template<typename T, StorageOrder order>
+void check_elementwise(const matrix<T, order>& A, const matrix<T, order>& B){
+    if (!A.is_compressed() || !B.is_compressed()){
+        throw std::runtime_error("Matrices must be compressed");
+    }
+    if (A.get_rows() != B.get_rows() || A.get_cols() != B.get_cols()){
+        throw std::invalid_argument("Matrix dimensions do not match");
+    }
+}
+
+// How the in-place operations find out whether two matrices share the same sparsity pattern
+enum class Pattern{
+    check,  // Compare the index vectors, unless both operands are the same matrix
+    same    // Trusted without comparing (e.g. B built by apply() or scale() from A), only the sizes are checked
+};
+
+// Check if two compressed matrices have the same sparsity pattern
+template<typename T, StorageOrder order>
+bool same_pattern(const matrix<T, order>& A, const matrix<T, order>& B){
+    check_elementwise(A, B);
+    if (&A == &B){
+        return true;
+    }
+    const auto& a_inner = A.get_inner_indices();
+    const auto& b_inner = B.get_inner_indices();
+    if (a_inner.size() != b_inner.size()){
+        return false;
+    }
+    // Full comparison of the index vectors, linear in the number of non-zero elements
+    return A.get_outer_start() == B.get_outer_start() && a_inner == b_inner;
+}
+
+// Merge two compressed matrices, op(a, b) is called with T() for a missing entry.
+// With intersect only the entries present in both matrices are kept, otherwise their union.
+template<bool intersect, typename T, StorageOrder order, typename Op>
+matrix<T, order> merge(const matrix<T, order>& A, const matrix<T, order>& B, Op op, std::size_t num_threads = 0){
+    check_elementwise(A, B);
+
+    const auto& a_outer = A.get_outer_start();
+    const auto& a_inner = A.get_inner_indices();
+    const auto& a_values = A.get_values();
+    const auto& b_outer = B.get_outer_start();
+    const auto& b_inner = B.get_inner_indices();
+    const auto& b_values = B.get_values();
+    std::size_t n = a_outer.size() - 1;  // number of rows or columns
+
+    // Symbolic pass: count the entries of each row of the result
+    std::vector<std::size_t> outer_start(n + 1, 0);
+    parallel_for(n, [&](std::size_t begin, std::size_t end){
+        for (std::size_t k = begin; k < end; ++k){
+            std::size_t ia = a_outer[k];
+            std::size_t ib = b_outer[k];
+            std::size_t count = 0;
+            while (ia < a_outer[k + 1] && ib < b_outer[k + 1]){
+                if (a_inner[ia] == b_inner[ib]){
+                    ++ia;
+                    ++ib;
+                    ++count;
+                }
+                else if (a_inner[ia] < b_inner[ib]){
+                    ++ia;
+                    count += !intersect;
+                }
+                else{
+                    ++ib;
+                    count += !intersect;
+                }
+            }
+            if constexpr (!intersect){
+                count += (a_outer[k + 1] - ia) + (b_outer[k + 1] - ib);  // remaining entries
+            }
+            outer_start[k + 1] = count;
+        }
+    }, num_threads);
+
+    for (std::size_t k = 1; k <= n; ++k){
+        outer_start[k] += outer_start[k - 1];   // Cumulative sum to get the start index of each row
+    }
+
+    // Numeric pass: merge the rows at their final position
+    std::vector<std::size_t> inner_indices(outer_start[n]);
+    std::vector<T> values(outer_start[n]);
+    parallel_for(n, [&](std::size_t begin, std::size_t end){
+        for (std::size_t k = begin; k < end; ++k){
+            std::size_t ia = a_outer[k];
+            std::size_t ib = b_outer[k];
+            std::size_t idx = outer_start[k];
+            while (ia < a_outer[k + 1] && ib < b_outer[k + 1]){
+                if (a_inner[ia] == b_inner[ib]){
+                    inner_indices[idx] = a_inner[ia];
+                    values[idx++] = op(a_values[ia++], b_values[ib++]);
+                }
+                else if (a_inner[ia] < b_inner[ib]){
+                    if constexpr (!intersect){
+                        inner_indices[idx] = a_inner[ia];
+                        values[idx++] = op(a_values[ia], T());
+                    }
+                    ++ia;
+                }
+                else{
+                    if constexpr (!intersect){
+                        inner_indices[idx] = b_inner[ib];
+                        values[idx++] = op(T(), b_values[ib]);
+                    }
+                    ++ib;
+                }
+            }
+            if constexpr (!intersect){
+                // remaining entries of A or B
+                for (; ia < a_outer[k + 1]; ++ia){
+                    inner_indices[idx] = a_inner[ia];
+                    values[idx++] = op(a_values[ia], T());
+                }
+                for (; ib < b_outer[k + 1]; ++ib){
+                    inner_indices[idx] = b_inner[ib];
+                    values[idx++] = op(T(), b_values[ib]);
+                }
+            }
+        }
+    }, num_threads);
+
+    matrix<T, order> result;
+    result.set_compressed(A.get_rows(), A.get_cols(), std::move(outer_start), std::move(inner_indices), std::move(values));
+    return result;
+}
+
+// alpha * A + beta * B
+template<typename T, StorageOrder order>
+matrix<T, order> axpby(std::type_identity_t<T> alpha, const matrix<T, order>& A, std::type_identity_t<T> beta, const matrix<T, order>& B, std::size_t num_threads = 0){
+    return merge<false>(A, B, [alpha, beta](const T& a, const T& b){ return alpha * a + beta * b; }, num_threads);
+}
+
+// Hadamard (element-wise) product A ∘ B
+template<typename T, StorageOrder order>
+matrix<T, order> hadamard(const matrix<T, order>& A, const matrix<T, order>& B, std::size_t num_threads = 0){
+    return merge<true>(A, B, [](const T& a, const T& b){ return a * b; }, num_threads);
+}
+
+// Apply func to every non-zero element, the sparsity pattern is kept
+template<typename T, StorageOrder order, typename Func>
+matrix<T, order> apply(const matrix<T, order>& A, Func func, std::size_t num_threads = 0){
+    if (!A.is_compressed()){
+        throw std::runtime_error("Matrix must be compressed");
+    }
+    const auto& a_values = A.get_values();
+    std::vector<T> values(a_values.size());
+    parallel_for(values.size(), [&](std::size_t begin, std::size_t end){
+        for (std::size_t idx = begin; idx < end; ++idx){
+            values[idx] = func(a_values[idx]);
+        }
+    }, num_threads);
+
+    matrix<T, order> result;
+    result.set_compressed(A.get_rows(), A.get_cols(), A.get_outer_start(), A.get_inner_indices(), std::move(values));
+    return result;
+}
+
+// alpha * A
+template<typename T, StorageOrder order>
+matrix<T, order> scale(std::type_identity_t<T> alpha, const matrix<T, order>& A, std::size_t num_threads = 0){
+    return apply(A, [alpha](const T& a){ return alpha * a; }, num_threads);
+}
+
+// Sum of two matrices
+template<typename T, StorageOrder order>
+matrix<T, order> operator+(const matrix<T, order>& A, const matrix<T, order>& B){
+    return axpby(T(1), A, T(1), B);
+}
+
+// Difference of two matrices
+template<typename T, StorageOrder order>
+matrix<T, order> operator-(const matrix<T, order>& A, const matrix<T, order>& B){
+    return axpby(T(1), A, T(-1), B);
+}
+
+// Apply func to every non-zero element in place
+template<typename T, StorageOrder order, typename Func>
+void apply_inplace(matrix<T, order>& A, Func func, std::size_t num_threads = 0){
+    if (!A.is_compressed()){
+        throw std::runtime_error("Matrix must be compressed");
+    }
+    std::span<T> values = A.get_values_mutable();
+    parallel_for(values.size(), [&](std::size_t begin, std::size_t end){
+        for (std::size_t idx = begin; idx < end; ++idx){
+            values[idx] = func(values[idx]);
+        }
+    }, num_threads);
+}
+
+// A = alpha * A
+template<typename T, StorageOrder order>
+void scale_inplace(std::type_identity_t<T> alpha, matrix<T, order>& A, std::size_t num_threads = 0){
+    apply_inplace(A, [alpha](const T& a){ return alpha * a; }, num_threads);
+}
+
+// Check if an in-place operation can update the values of A directly
+template<typename T, StorageOrder order>
+bool inplace_pattern(const matrix<T, order>& A, const matrix<T, order>& B, Pattern pattern){
+    if (pattern == Pattern::check){
+        return same_pattern(A, B);
+    }
+    check_elementwise(A, B);
+    if (A.get_nnz() != B.get_nnz()){
+        throw std::invalid_argument("Matrices do not share the same sparsity pattern");
+    }
+    return true;
+}
+
+// A = alpha * A + beta * B, updated in place when A and B share the same sparsity pattern.
+// With Pattern::same the comparison of the patterns is skipped for repeated updates.
+template<typename T, StorageOrder order>
+void axpby_inplace(std::type_identity_t<T> alpha, matrix<T, order>& A, std::type_identity_t<T> beta, const matrix<T, order>& B,
+                   std::size_t num_threads = 0, Pattern pattern = Pattern::check){
+    if (!inplace_pattern(A, B, pattern)){
+        A = axpby(alpha, A, beta, B, num_threads);
+        return;
+    }
+    std::span<T> a_values = A.get_values_mutable();
+    const auto& b_values = B.get_values();
+    parallel_for(a_values.size(), [&](std::size_t begin, std::size_t end){
+        for (std::size_t idx = begin; idx < end; ++idx){
+            a_values[idx] = alpha * a_values[idx] + beta * b_values[idx];
+        }
+    }, num_threads);
+}
+
+// A = A ∘ B, updated in place when A and B share the same sparsity pattern
+template<typename T, StorageOrder order>
+void hadamard_inplace(matrix<T, order>& A, const matrix<T, order>& B, std::size_t num_threads = 0, Pattern pattern = Pattern::check){
+    if (!inplace_pattern(A, B, pattern)){
+        A = hadamard(A, B, num_threads);
+        return;
+    }
+    std::span<T> a_values = A.get_values_mutable();
+    const auto& b_values = B.get_values();
+    parallel_for(a_values.size(), [&](std::size_t begin, std::size_t end){
+        for (std::size_t idx = begin; idx < end; ++idx){
+            a_values[idx] *= b_values[idx];
+        }
+    }, num_threads);
+}
+
+}
+
+#endif
@@ -0,0 +1,366 @@
+#ifndef MATRIX_POWERS_HPP
+#define MATRIX_POWERS_HPP
+
+#include "matrix.hpp"
+#include "parallel.hpp"
+#include <cstdint>
+#include <limits>
+
+// Communication-avoiding matrix powers kernel computing [x, Ax, A^2x, ..., A^s x].
+// Rows are split into blocks small enough to stay in cache. For every block the rows it
+// depends on through s products (its ghost region) are found level by level, the
+// column indices of the corresponding rows are renumbered locally, and all s powers are
+// computed on these rows while they are cache resident. The matrix is thus read from
+// main memory about once instead of s times, at the price of redundant work on ghost rows,
+// so the kernel pays off for matrices with local structure (banded, meshes). Matrices whose
+// ghost regions grow too large are handled with plain sweeps instead.
+
+namespace algebra {
+
+// Dense block of column vectors stored contiguously one after the other
+template<typename T>
+class basis_block{
+    private:
+    std::size_t rows = 0;
+    std::size_t cols = 0;
+    std::vector<T> data;  // Column-major values
+
+    public:
+    // Constructor
+    basis_block(std::size_t r, std::size_t c): rows(r), cols(c), data(r * c, T()) {}
+
+    // Get number of rows
+    std::size_t get_rows() const{
+        return rows;
+    }
+
+    // Get number of columns
+    std::size_t get_cols() const{
+        return cols;
+    }
+
+    T operator()(std::size_t i, std::size_t k) const{
+        return data[k * rows + i];
+    }
+
+    T& operator()(std::size_t i, std::size_t k){
+        return data[k * rows + i];
+    }
+
+    // Get column k as a contiguous range
+    std::span<const T> column(std::size_t k) const{
+        return std::span<const T>(data.data() + k * rows, rows);
+    }
+
+    std::span<T> column(std::size_t k){
+        return std::span<T>(data.data() + k * rows, rows);
+    }
+
+    // Get the column-major values, leading dimension is get_rows()
+    const T* get_data() const{
+        return data.data();
+    }
+
+    T* get_data(){
+        return data.data();
+    }
+};
+
+// Reusable plan of the matrix powers kernel for the sparsity pattern of a compressed square
+// row-major matrix. Building the plan finds the row blocks, their ghost levels and the local
+// column indices once; apply() then only streams the blocks and computes the powers, so the
+// plan should be built once and applied to every new vector (or to new values with the same
+// pattern). Blocks are grown or shrunk until their actual working set, ghost rows included,
+// fits in cache_bytes. If the ghost rows of all the blocks exceed max_ghost_fraction of the
+// rows the redundant work would outweigh the saved traffic, and apply() falls back to s plain
+// sweeps over the matrix.
+template<typename T>
+class powers_plan{
+    private:
+    std::size_t n = 0;  // Number of rows of the matrix
+    std::size_t nnz = 0;  // Number of non-zero elements of the matrix
+    std::size_t steps = 0;  // Number of powers s
+    bool fallback = false;  // Use s plain sweeps instead of the blocks
+    std::size_t ghost_rows = 0;  // Ghost rows summed over the blocks
+    std::size_t max_local = 0;  // Largest number of local rows of a block
+    std::size_t traffic = 0;  // Estimated bytes read and written by apply()
+
+    // Block b holds the rows [block_start[b], block_start[b+1])
+    std::vector<std::size_t> block_start{0};
+    // Global rows of block b in local order are list[list_start[b] .. list_start[b+1]),
+    // the block rows come first and the levels are nested prefixes
+    std::vector<std::size_t> list_start{0};
+    std::vector<std::size_t> list;
+    // Local rows of level k of block b are the first level_end[b * (steps + 1) + k]
+    std::vector<std::size_t> level_end;
+    // Local row p of block b (p < rows of level 1) has the local column indices
+    // local_inner[local_outer[row_start[b] + p] .. local_outer[row_start[b] + p + 1]),
+    // its values start at values[value_start[row_start[b] + p]] in the matrix
+    std::vector<std::size_t> row_start{0};
+    std::vector<std::size_t> local_outer;
+    std::vector<std::size_t> value_start;
+    std::vector<std::uint32_t> local_inner;
+
+    public:
+    // Constructor, builds the plan for the pattern of mat
+    powers_plan(const matrix<T, StorageOrder::row_major>& mat, std::size_t s,
+                std::size_t cache_bytes = std::size_t(1) << 18, double max_ghost_fraction = 0.5): n(mat.get_rows()), steps(s){
+        if (!mat.is_compressed()){
+            throw std::runtime_error("Matrix must be compressed");
+        }
+        if (mat.get_rows() != mat.get_cols()){
+            throw std::invalid_argument("Matrix must be square");
+        }
+        const auto& outer_start = mat.get_outer_start();
+        const auto& inner_indices = mat.get_inner_indices();
+        nnz = inner_indices.size();
+        if (steps == 0 || n == 0){
+            return;
+        }
+
+        // Bytes of a local row that is expanded (index, value, offsets) and of a vector entry
+        constexpr std::size_t entry_bytes = sizeof(std::uint32_t) + sizeof(T);
+        constexpr std::size_t row_bytes = 2 * sizeof(std::size_t);
+        constexpr std::size_t vector_bytes = sizeof(std::size_t) + 2 * sizeof(T);
+
+        // First guess ignoring the ghost rows, corrected block by block from the actual working set
+        std::size_t avg_row_nnz = (nnz + n - 1) / n;
+        std::size_t guess = std::max<std::size_t>(1, cache_bytes / (row_bytes + avg_row_nnz * entry_bytes + vector_bytes));
+
+        constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+        std::vector<std::size_t> pos(n, npos);  // Local position of a ghost row while its block is built
+        std::size_t ghost_limit = static_cast<std::size_t>(max_ghost_fraction * n);
+
+        std::size_t row_begin = 0;
+        while (row_begin < n){
+            std::size_t rows = std::min(guess, n - row_begin);
+            std::size_t list_size = list.size();
+            std::size_t outer_size = local_outer.size();
+            std::size_t inner_size = local_inner.size();
+            std::size_t levels_size = level_end.size();
+
+            while (true){
+                // Level s holds the rows of the block, their local position is r - row_begin
+                std::size_t first = list.size();
+                for (std::size_t r = row_begin; r < row_begin + rows; ++r){
+                    list.push_back(r);
+                }
+                level_end.resize(levels_size + steps + 1);
+                std::size_t* levels = level_end.data() + levels_size;
+                levels[steps] = rows;
+
+                // Level k adds the columns referenced by the rows of level k + 1 (ghost region),
+                // rows are expanded in local order so local_outer follows the local numbering
+                std::size_t expanded = 0;
+                std::size_t working_set = 0;
+                for (std::size_t k = steps; k-- > 0;){
+                    for (std::size_t p = expanded; p < levels[k + 1]; ++p){
+                        std::size_t row = list[first + p];
+                        local_outer.push_back(local_inner.size());
+                        value_start.push_back(outer_start[row]);
+                        for (std::size_t idx = outer_start[row]; idx < outer_start[row + 1]; ++idx){
+                            std::size_t col = inner_indices[idx];
+                            std::size_t local;
+                            if (col - row_begin < rows){
+                                local = col - row_begin;  // column inside the block
+                            }
+                            else{
+                                if (pos[col] == npos){
+                                    pos[col] = list.size() - first;
+                                    list.push_back(col);
+                                }
+                                local = pos[col];
+                            }
+                            local_inner.push_back(static_cast<std::uint32_t>(local));
+                        }
+                        working_set += row_bytes + (outer_start[row + 1] - outer_start[row]) * entry_bytes;
+                    }
+                    expanded = levels[k + 1];
+                    levels[k] = list.size() - first;
+                }
+                local_outer.push_back(local_inner.size());
+                value_start.push_back(0);  // unused, keeps the arrays aligned
+                std::size_t local_rows = levels[0];
+                working_set += local_rows * vector_bytes;
+
+                // Reset the scratch positions of the ghost rows
+                for (std::size_t p = first + rows; p < list.size(); ++p){
+                    pos[list[p]] = npos;
+                }
+
+                bool fits = working_set <= cache_bytes && local_rows <= std::numeric_limits<std::uint32_t>::max();
+                if (fits || rows == 1){
+                    if (local_rows > std::numeric_limits<std::uint32_t>::max()){
+                        fallback = true;  // local indices would overflow
+                    }
+                    // Grow the next block when this one uses less than half the cache
+                    guess = working_set < cache_bytes / 2 ? 2 * rows : rows;
+                    ghost_rows += local_rows - rows;
+                    max_local = std::max(max_local, local_rows);
+                    traffic += working_set + rows * steps * sizeof(T);
+                    break;
+                }
+
+                // Too large, drop the block and retry with fewer rows
+                list.resize(list_size);
+                local_outer.resize(outer_size);
+                value_start.resize(outer_size);
+                local_inner.resize(inner_size);
+                level_end.resize(levels_size);
+                rows = std::max<std::size_t>(1, std::min(rows - 1, rows * cache_bytes / working_set));
+            }
+
+            block_start.push_back(row_begin + rows);
+            list_start.push_back(list.size());
+            row_start.push_back(local_outer.size());
+            row_begin += rows;
+
+            // Ghost rows only accumulate, stop as soon as the redundant work is too large
+            if (ghost_rows > ghost_limit || fallback){
+                fallback = true;
+                break;
+            }
+        }
+
+        if (fallback){
+            block_start.assign(1, 0);
+            list_start.assign(1, 0);
+            row_start.assign(1, 0);
+            std::vector<std::size_t>().swap(list);
+            std::vector<std::size_t>().swap(level_end);
+            std::vector<std::size_t>().swap(local_outer);
+            std::vector<std::size_t>().swap(value_start);
+            std::vector<std::uint32_t>().swap(local_inner);
+            // s sweeps over the matrix and two vectors
+            traffic = steps * ((n + 1) * sizeof(std::size_t) + nnz * (sizeof(std::size_t) + sizeof(T)) + 2 * n * sizeof(T));
+        }
+    }
+
+    // Get the number of powers
+    std::size_t get_steps() const{
+        return steps;
+    }
+
+    // Get the number of row blocks, 0 when plain sweeps are used
+    std::size_t get_num_blocks() const{
+        return block_start.size() - 1;
+    }
+
+    // Check if apply() falls back to plain sweeps because of the size of the ghost regions
+    bool uses_fallback() const{
+        return fallback;
+    }
+
+    // Get the ghost rows of all the blocks divided by the number of rows
+    double get_ghost_fraction() const{
+        return n == 0 ? 0 : static_cast<double>(ghost_rows) / n;
+    }
+
+    // Get the estimated number of bytes apply() moves from and to main memory
+    std::size_t get_traffic_bytes() const{
+        return traffic;
+    }
+
+    // Compute the basis [x, Ax, ..., A^s x], mat must have the sparsity pattern the plan was built for
+    template<typename T2>
+    requires is_arithmetic_or_complex<T2>::value  // limitation to arithmetic or complex types
+    auto apply(const matrix<T, StorageOrder::row_major>& mat, const std::vector<T2>& vec, std::size_t num_threads = 0) const{
+        // Matrix and vector types must be compatible
+        static_assert(std::is_convertible_v<T, T2> || std::is_convertible_v<T2, T>, "Matrix and vector types must be compatible");
+        if (!mat.is_compressed()){
+            throw std::runtime_error("Matrix must be compressed");
+        }
+        if (mat.get_rows() != n || mat.get_cols() != n || mat.get_nnz() != nnz){
+            throw std::invalid_argument("Matrix does not match the plan");
+        }
+        if (vec.size() != n){
+            throw std::invalid_argument("Matrix and vector dimensions do not match");
+        }
+
+        using result_type = std::common_type_t<T, T2>;
+        const auto& values = mat.get_values();
+
+        basis_block<result_type> basis(n, steps + 1);
+        for (std::size_t i = 0; i < n; ++i){
+            basis(i, 0) = vec[i];
+        }
+        if (steps == 0 || n == 0){
+            return basis;
+        }
+
+        if (fallback){
+            // Plain sweeps, one product per power
+            const auto& outer_start = mat.get_outer_start();
+            const auto& inner_indices = mat.get_inner_indices();
+            for (std::size_t k = 1; k <= steps; ++k){
+                std::span<const result_type> x = basis.column(k - 1);
+                std::span<result_type> y = basis.column(k);
+                parallel_for(n, [&](std::size_t begin, std::size_t end){
+                    for (std::size_t i = begin; i < end; ++i){
+                        result_type sum = result_type{};
+                        for (std::size_t idx = outer_start[i]; idx < outer_start[i + 1]; ++idx){
+                            sum += static_cast<result_type>(values[idx]) * x[inner_indices[idx]];
+                        }
+                        y[i] = sum;
+                    }
+                }, num_threads);
+            }
+            return basis;
+        }
+
+        // Blocks are independent, each thread processes a range of them with its own scratch vectors
+        parallel_for(get_num_blocks(), [&](std::size_t first_block, std::size_t last_block){
+            std::vector<result_type> current(max_local);
+            std::vector<result_type> next(max_local);
+
+            for (std::size_t block = first_block; block < last_block; ++block){
+                std::size_t row_begin = block_start[block];
+                const std::size_t* rows = list.data() + list_start[block];
+                const std::size_t* levels = level_end.data() + block * (steps + 1);
+                const std::size_t* outer = local_outer.data() + row_start[block];
+                const std::size_t* starts = value_start.data() + row_start[block];
+
+                // Level 0 values are the input vector
+                for (std::size_t p = 0; p < levels[0]; ++p){
+                    current[p] = vec[rows[p]];
+                }
+
+                // All powers computed on the cache resident rows
+                for (std::size_t k = 1; k <= steps; ++k){
+                    for (std::size_t p = 0; p < levels[k]; ++p){
+                        const T* row_values = values.data() + starts[p];
+                        const std::uint32_t* row_inner = local_inner.data() + outer[p];
+                        std::size_t row_nnz = outer[p + 1] - outer[p];
+                        result_type sum = result_type{};
+                        for (std::size_t e = 0; e < row_nnz; ++e){
+                            sum += static_cast<result_type>(row_values[e]) * current[row_inner[e]];
+                        }
+                        next[p] = sum;
+                    }
+                    // Rows of the block are the first local rows, in order
+                    std::copy(next.begin(), next.begin() + levels[steps], basis.column(k).begin() + row_begin);
+                    std::swap(current, next);
+                }
+            }
+        }, num_threads, 1);
+
+        return basis;
+    }
+};
+
+// Compute the basis [x, Ax, ..., A^s x] of a compressed square row-major matrix.
+// cache_bytes is the size of the cache the blocks should fit in. The plan is built on every
+// call, build a powers_plan once and apply it when the kernel is called repeatedly.
+template<typename T, typename T2>
+requires is_arithmetic_or_complex<T>::value && is_arithmetic_or_complex<T2>::value  // limitation to arithmetic or complex types
+auto matrix_powers(const matrix<T, StorageOrder::row_major>& mat, const std::vector<T2>& vec, std::size_t s,
+                   std::size_t cache_bytes = std::size_t(1) << 18, std::size_t num_threads = 0){
+    if (mat.get_cols() != vec.size()){
+        throw std::invalid_argument("Matrix and vector dimensions do not match");
+    }
+    return powers_plan<T>(mat, s, cache_bytes).apply(mat, vec, num_threads);
+}
+
+}
+
+#endif
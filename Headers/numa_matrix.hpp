@@ -0,0 +1,417 @@
+#ifndef NUMA_MATRIX_HPP
+#define NUMA_MATRIX_HPP
+
+#include "matrix.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// NUMA-aware placement of compressed row-major matrices and vectors.
+// Rows are split into one block per thread with balanced non-zeros. Every thread of a
+// pinned team allocates nothing but first-touches the pages of its own block, so the
+// operating system places them on the memory node of the core that later computes them.
+// The Linux first-touch policy is used directly, no NUMA library is needed.
+
+namespace algebra {
+
+// Enumerator that indicates how data is placed in memory
+enum class Placement{naive, numa_aware};
+
+// Cpus available to the process, grouped node by node so that consecutive threads share a node
+inline std::vector<int> numa_cpu_order(){
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    bool has_mask = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+    // Read the cpu list of every node, e.g. "0-15,32-47"
+    for (int node = 0; ; ++node){
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (!file.is_open()){
+            break;
+        }
+        std::string list;
+        std::getline(file, list);
+        std::istringstream iss(list);
+        std::string range;
+        while (std::getline(iss, range, ',')){
+            if (range.empty()){
+                continue;
+            }
+            std::size_t dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; ++cpu){
+                if (!has_mask || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))){
+                    cpus.push_back(cpu);
+                }
+            }
+        }
+    }
+    // No node information, use the allowed cpus in order
+    if (cpus.empty() && has_mask){
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu){
+            if (CPU_ISSET(cpu, &allowed)){
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#endif
+    if (cpus.empty()){
+        for (unsigned int cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu){
+            cpus.push_back(static_cast<int>(cpu));
+        }
+    }
+    return cpus;
+}
+
+// Pin the calling thread to a cpu, returns false if not supported
+inline bool pin_current_thread(int cpu){
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+// Array whose pages are left untouched at allocation, to be first-touched by the threads using them
+template<typename T>
+class first_touch_array{
+    private:
+    static constexpr std::align_val_t alignment{4096};  // page aligned
+    T* ptr = nullptr;
+    std::size_t n = 0;
+
+    public:
+    static_assert(std::is_trivially_copyable_v<T>, "first_touch_array requires trivially copyable types");
+
+    // Constructor, the elements are not initialized
+    explicit first_touch_array(std::size_t size = 0):
+     ptr(size ? static_cast<T*>(::operator new(size * sizeof(T), alignment)) : nullptr), n(size) {}
+
+    first_touch_array(const first_touch_array&) = delete;
+    first_touch_array& operator=(const first_touch_array&) = delete;
+
+    first_touch_array(first_touch_array&& rhs) noexcept: ptr(rhs.ptr), n(rhs.n) {
+        rhs.ptr = nullptr;
+        rhs.n = 0;
+    }
+
+    first_touch_array& operator=(first_touch_array&& rhs) noexcept{
+        std::swap(ptr, rhs.ptr);
+        std::swap(n, rhs.n);
+        return *this;
+    }
+
+    ~first_touch_array(){
+        if (ptr){
+            ::operator delete(ptr, alignment);
+        }
+    }
+
+    std::size_t size() const{
+        return n;
+    }
+
+    T* data(){
+        return ptr;
+    }
+
+    const T* data() const{
+        return ptr;
+    }
+
+    T& operator[](std::size_t i){
+        return ptr[i];
+    }
+
+    const T& operator[](std::size_t i) const{
+        return ptr[i];
+    }
+};
+
+// Team of persistent threads, thread t is pinned to the t-th cpu of numa_cpu_order()
+class pinned_team{
+    private:
+    std::vector<std::thread> threads;
+    std::mutex team_mutex;
+    std::mutex run_mutex;  // Serializes concurrent calls to run()
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+    std::function<void(std::size_t)> task;  // Task of the current run
+    std::size_t generation = 0;  // Incremented at every run
+    std::size_t remaining = 0;  // Threads still running the current task
+    bool stopping = false;
+    std::vector<std::exception_ptr> errors;
+
+    // Thread loop, waits for a new generation and runs the task
+    void work(std::size_t t, int cpu, bool pin){
+        if (pin){
+            pin_current_thread(cpu);
+        }
+        std::size_t seen = 0;
+        std::unique_lock<std::mutex> lock(team_mutex);
+        while (true){
+            start_cv.wait(lock, [&]{ return stopping || generation != seen; });
+            if (stopping){
+                return;
+            }
+            seen = generation;
+            lock.unlock();
+            try{
+                task(t);
+            }
+            catch (...){
+                errors[t] = std::current_exception();
+            }
+            lock.lock();
+            if (--remaining == 0){
+                done_cv.notify_one();
+            }
+        }
+    }
+
+    public:
+    // Constructor, starts num_threads threads (one per available cpu if 0), pinned if pin is true
+    explicit pinned_team(std::size_t num_threads = 0, bool pin = true){
+        std::vector<int> cpus = numa_cpu_order();
+        if (num_threads == 0){
+            num_threads = cpus.size();
+        }
+        errors.resize(num_threads);
+        for (std::size_t t = 0; t < num_threads; ++t){
+            int cpu = cpus[t % cpus.size()];
+            threads.emplace_back([this, t, cpu, pin]{ work(t, cpu, pin); });
+        }
+    }
+
+    pinned_team(const pinned_team&) = delete;
+    pinned_team& operator=(const pinned_team&) = delete;
+
+    ~pinned_team(){
+        {
+            std::lock_guard<std::mutex> lock(team_mutex);
+            stopping = true;
+        }
+        start_cv.notify_all();
+        for (auto& thread : threads){
+            thread.join();
+        }
+    }
+
+    // Number of threads
+    std::size_t size() const{
+        return threads.size();
+    }
+
+    // Run func(t) on every thread t and wait for all of them.
+    // Concurrent callers are served one after the other, func must not call run() itself.
+    void run(std::function<void(std::size_t)> func){
+        std::lock_guard<std::mutex> run_lock(run_mutex);
+        std::unique_lock<std::mutex> lock(team_mutex);
+        task = std::move(func);
+        remaining = threads.size();
+        std::fill(errors.begin(), errors.end(), nullptr);
+        generation++;
+        start_cv.notify_all();
+        done_cv.wait(lock, [this]{ return remaining == 0; });
+        // Rethrow the first exception raised by a thread
+        for (auto& error : errors){
+            if (error){
+                std::rethrow_exception(error);
+            }
+        }
+    }
+};
+
+// Vector split in blocks, block t is first-touched by thread t of the team
+template<typename T>
+class numa_vector{
+    private:
+    first_touch_array<T> values;
+    std::vector<std::size_t> bounds;  // Block t is [bounds[t], bounds[t+1])
+
+    public:
+    // Constructor, the elements are not initialized
+    numa_vector(std::vector<std::size_t> b): values(b.back()), bounds(std::move(b)) {}
+
+    std::size_t size() const{
+        return values.size();
+    }
+
+    // Get the block bounds
+    const std::vector<std::size_t>& get_bounds() const{
+        return bounds;
+    }
+
+    T* data(){
+        return values.data();
+    }
+
+    const T* data() const{
+        return values.data();
+    }
+
+    T& operator[](std::size_t i){
+        return values[i];
+    }
+
+    const T& operator[](std::size_t i) const{
+        return values[i];
+    }
+
+    // Copy into a std::vector
+    std::vector<T> to_vector() const{
+        return std::vector<T>(values.data(), values.data() + values.size());
+    }
+};
+
+// Compressed row-major matrix with rows split in blocks placed on the memory node of the thread computing them
+template<typename T>
+class numa_matrix{
+    private:
+    pinned_team& team;
+    Placement placement;
+    std::size_t rows = 0;
+    std::size_t cols = 0;
+    std::vector<std::size_t> row_bounds;  // Row block t is [row_bounds[t], row_bounds[t+1])
+    std::vector<std::size_t> col_bounds;  // Blocks of input vectors
+
+    // Compression vectors
+    first_touch_array<std::size_t> outer_start;
+    first_touch_array<std::size_t> inner_indices;
+    first_touch_array<T> values;
+
+    // Run func(t) for every block, on the team or sequentially on the calling thread for naive placement
+    void place(const std::function<void(std::size_t)>& func){
+        if (placement == Placement::numa_aware){
+            team.run(func);
+        }
+        else{
+            for (std::size_t t = 0; t < team.size(); ++t){
+                func(t);
+            }
+        }
+    }
+
+    public:
+
+    // Limit to arithmetic or complex types
+    static_assert(is_arithmetic_or_complex<T>::value, "Matrix can only be of arithmetic or complex types");
+
+    // Constructor, copies a compressed row-major matrix
+    numa_matrix(const matrix<T, StorageOrder::row_major>& mat, pinned_team& t, Placement p = Placement::numa_aware):
+     team(t), placement(p), rows(mat.get_rows()), cols(mat.get_cols()) {
+
+        if (!mat.is_compressed()){
+            throw std::runtime_error("Matrix must be compressed");
+        }
+        const auto& src_outer = mat.get_outer_start();
+        const auto& src_inner = mat.get_inner_indices();
+        const auto& src_values = mat.get_values();
+        std::size_t nnz = src_values.size();
+        std::size_t blocks = team.size();
+
+        // Split rows so that every block holds about the same number of non-zeros
+        row_bounds.assign(blocks + 1, rows);
+        row_bounds[0] = 0;
+        for (std::size_t b = 1; b < blocks; ++b){
+            std::size_t target = nnz * b / blocks;
+            std::size_t row = std::lower_bound(src_outer.begin(), src_outer.end(), target) - src_outer.begin();
+            row_bounds[b] = std::max(row_bounds[b - 1], std::min(row, rows));
+        }
+
+        // Input vectors are split proportionally to the rows, identically for square matrices
+        col_bounds.resize(blocks + 1);
+        for (std::size_t b = 0; b <= blocks; ++b){
+            col_bounds[b] = rows == cols ? row_bounds[b] : (rows == 0 ? 0 : row_bounds[b] * cols / rows);
+        }
+        col_bounds[blocks] = cols;
+
+        outer_start = first_touch_array<std::size_t>(rows + 1);
+        inner_indices = first_touch_array<std::size_t>(nnz);
+        values = first_touch_array<T>(nnz);
+
+        // Every block is copied by the thread that computes it
+        place([&](std::size_t b){
+            std::size_t row_begin = row_bounds[b];
+            std::size_t row_end = row_bounds[b + 1];
+            std::copy(src_outer.begin() + row_begin, src_outer.begin() + row_end, outer_start.data() + row_begin);
+            std::copy(src_inner.begin() + src_outer[row_begin], src_inner.begin() + src_outer[row_end], inner_indices.data() + src_outer[row_begin]);
+            std::copy(src_values.begin() + src_outer[row_begin], src_values.begin() + src_outer[row_end], values.data() + src_outer[row_begin]);
+        });
+        outer_start[rows] = nnz;
+    }
+
+    // Get number of rows
+    std::size_t get_rows() const{
+        return rows;
+    }
+
+    // Get number of columns
+    std::size_t get_cols() const{
+        return cols;
+    }
+
+    // Get the row blocks
+    const std::vector<std::size_t>& get_row_bounds() const{
+        return row_bounds;
+    }
+
+    // Create an input vector, every block is copied by the thread reading it the most
+    numa_vector<T> make_input(const std::vector<T>& vec){
+        if (vec.size() != cols){
+            throw std::invalid_argument("Matrix and vector dimensions do not match");
+        }
+        numa_vector<T> result(col_bounds);
+        place([&](std::size_t b){
+            std::copy(vec.begin() + col_bounds[b], vec.begin() + col_bounds[b + 1], result.data() + col_bounds[b]);
+        });
+        return result;
+    }
+
+    // Create an output vector, every block is zeroed by the thread writing it
+    numa_vector<T> make_output(){
+        numa_vector<T> result(row_bounds);
+        place([&](std::size_t b){
+            std::fill(result.data() + row_bounds[b], result.data() + row_bounds[b + 1], T());
+        });
+        return result;
+    }
+
+    // Multiplication y = A * x, every thread computes its own row block
+    void multiply(const numa_vector<T>& x, numa_vector<T>& y){
+        // Check if the dimensions of the matrix and vectors match
+        if (x.size() != cols || y.size() != rows){
+            throw std::invalid_argument("Matrix and vector dimensions do not match");
+        }
+        team.run([&](std::size_t b){
+            for (std::size_t i = row_bounds[b]; i < row_bounds[b + 1]; ++i){
+                T sum = T();
+                // loop over the non-zero values in the current row
+                for (std::size_t idx = outer_start[i]; idx < outer_start[i + 1]; ++idx){
+                    sum += values[idx] * x[inner_indices[idx]];
+                }
+                y[i] = sum;
+            }
+        });
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,674 @@
+#ifndef PANEL_MATRIX_HPP
+#define PANEL_MATRIX_HPP
+
+#include "matrix.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <future>
+
+namespace algebra {
+
+// Header written at the beginning of a panel file
+struct panel_file_header{
+    char magic[8];  // Identifies the file format
+    std::uint64_t value_size = 0;  // sizeof(T) used when the file was written
+    std::uint64_t rows = 0;  // Number of rows
+    std::uint64_t cols = 0;  // Number of columns
+    std::uint64_t nnz = 0;  // Number of non-zero elements
+    std::uint64_t num_panels = 0;  // Number of row panels
+    std::uint64_t index_offset = 0;  // Position of the panel index table in the file
+};
+
+// Entry of the panel index table
+struct panel_info{
+    std::uint64_t row_begin = 0;  // First row of the panel
+    std::uint64_t row_end = 0;  // One past the last row of the panel
+    std::uint64_t nnz = 0;  // Number of non-zero elements in the panel
+    std::uint64_t offset = 0;  // Position of the panel data in the file
+};
+
+// Magic string of the panel format
+inline constexpr char panel_magic[8] = {'S','P','M','P','A','N','E','L'};
+
+// Bytes needed in memory to hold a compressed panel
+template<typename T>
+constexpr std::size_t panel_bytes(std::size_t panel_rows, std::size_t nnz){
+    return (panel_rows + 1) * sizeof(std::size_t) + nnz * (sizeof(std::size_t) + sizeof(T));
+}
+
+// A row panel loaded in memory, stored in CSR format with local row indices
+template<typename T>
+struct row_panel{
+    std::size_t row_begin = 0;  // First global row of the panel
+    std::size_t row_end = 0;  // One past the last global row of the panel
+    std::vector<std::size_t> outer_start;  // Start of each local row in values vector
+    std::vector<std::size_t> inner_indices;  // Column indices
+    std::vector<T> values;  // Non-zero values
+};
+
+// Convert a matrix market file into the row-panel format in a single pass over the file.
+// Entries are spilled into one bucket file per group of rows, then every bucket is
+// sorted and cut into panels whose compressed size fits in half of memory_budget,
+// so that a panel can be computed on while the next one is being loaded.
+// Spill buffers, a loaded bucket and the panel being written are kept within memory_budget:
+// buckets that do not fit, e.g. because rows are unevenly filled, are split again, and a
+// single row too long to be sorted in memory is split by columns and written in chunks.
+template<typename T>
+void convert_mtx_to_panels(const std::string& mtx_file, const std::string& panel_file, std::size_t memory_budget){
+
+    static_assert(is_arithmetic_or_complex<T>::value, "Matrix can only be of arithmetic or complex types");
+    static_assert(sizeof(std::size_t) == sizeof(std::uint64_t), "Panel format requires 64-bit indices");
+
+    // One triplet as stored in the bucket files
+    struct triplet{
+        std::uint64_t row;
+        std::uint64_t col;
+        std::uint64_t seq;  // Position in the file, to keep the last of duplicated entries
+        T value;
+    };
+
+    std::ifstream file(mtx_file);
+    if (!file.is_open()){
+        throw std::runtime_error("file is not open");
+    }
+
+    // Read the header
+    std::string line;
+    while (std::getline(file, line)){
+        // skip comments and empty lines
+        if (line.empty() || line[0] == '%'){
+            continue;
+        }
+        break;
+    }
+
+    std::size_t rows = 0;
+    std::size_t cols = 0;
+    std::size_t nnz = 0;
+    std::istringstream iss(line);
+    iss >> rows >> cols >> nnz;
+
+    // Half of the budget for the panel being computed, half for the one being prefetched
+    std::size_t panel_budget = memory_budget / 2;
+    if (panel_budget < panel_bytes<T>(1, 0)){
+        throw std::invalid_argument("Memory budget too small");
+    }
+
+    // Estimate the number of rows of a bucket from the average number of non-zeros per row
+    std::size_t avg_row_nnz = rows == 0 ? 0 : (nnz + rows - 1) / rows;
+    std::size_t row_bytes = sizeof(std::size_t) + avg_row_nnz * (sizeof(std::size_t) + sizeof(T));
+    std::size_t rows_per_bucket = std::max<std::size_t>(1, panel_budget / row_bytes);
+    std::size_t num_buckets = rows == 0 ? 0 : (rows + rows_per_bucket - 1) / rows_per_bucket;
+
+    // In-memory spill buffers, flushed to the bucket files when full, all of them fit in panel_budget
+    if (num_buckets * (sizeof(triplet) + sizeof(std::vector<triplet>)) > panel_budget){
+        throw std::invalid_argument("Memory budget too small for the matrix dimensions");
+    }
+    std::size_t buffer_capacity = num_buckets == 0 ? 1 : panel_budget / (num_buckets * sizeof(triplet));
+    std::vector<std::vector<triplet>> buffers(num_buckets);
+    for (auto& buffer : buffers){
+        buffer.reserve(buffer_capacity);
+    }
+
+    // Bucket files are removed once processed, or when an exception is thrown
+    struct bucket_files{
+        std::vector<std::string> names;
+        ~bucket_files(){
+            for (const auto& name : names){
+                std::remove(name.c_str());
+            }
+        }
+    } files;
+
+    // Create an empty bucket file and return its name
+    auto new_bucket = [&](){
+        files.names.push_back(panel_file + ".bucket" + std::to_string(files.names.size()));
+        std::ofstream(files.names.back(), std::ios::binary | std::ios::trunc);
+        return files.names.back();
+    };
+
+    // Append the content of a buffer to a bucket file
+    auto flush = [](std::vector<triplet>& buffer, const std::string& name){
+        if (buffer.empty()){
+            return;
+        }
+        std::ofstream bucket(name, std::ios::binary | std::ios::app);
+        bucket.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(triplet));
+        if (!bucket){
+            throw std::runtime_error("cannot write bucket file");
+        }
+        buffer.clear();
+    };
+
+    // Pending buckets: file name and rows [row_begin, row_end)
+    struct bucket{
+        std::string name;
+        std::size_t row_begin;
+        std::size_t row_end;
+    };
+    std::vector<bucket> pending(num_buckets);
+    for (std::size_t b = num_buckets; b-- > 0;){
+        pending[num_buckets - 1 - b] = {new_bucket(), b * rows_per_bucket, std::min(rows, (b + 1) * rows_per_bucket)};
+    }
+
+    // Stream the entries of the matrix market file into the buckets
+    std::size_t i;
+    std::size_t j;
+    T value;
+    std::uint64_t seq = 0;
+    while (file >> i >> j >> value){
+        // Keeping the matrix Sparse
+        if (value == T()){
+            continue;
+        }
+        if (i == 0 || j == 0 || i > rows || j > cols){
+            throw std::out_of_range("Index out of range");
+        }
+        std::size_t b = (i - 1) / rows_per_bucket;
+        buffers[b].push_back({i - 1, j - 1, seq++, value});  // 1-based to 0-based index
+        if (buffers[b].size() >= buffer_capacity){
+            flush(buffers[b], pending[num_buckets - 1 - b].name);
+        }
+    }
+    file.close();
+
+    for (std::size_t b = 0; b < num_buckets; ++b){
+        flush(buffers[b], pending[num_buckets - 1 - b].name);
+    }
+    buffers = std::vector<std::vector<triplet>>();
+
+    std::ofstream out(panel_file, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()){
+        throw std::runtime_error("file is not open");
+    }
+
+    // Placeholder header, rewritten once the panel index is known
+    panel_file_header header;
+    std::memcpy(header.magic, panel_magic, sizeof(panel_magic));
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::vector<panel_info> panels;
+    std::size_t total_nnz = 0;
+
+    // Write the rows [first, last) of the sorted bucket entries as one panel,
+    // its compressed copy is at most panel_budget bytes
+    auto write_panel = [&](const std::vector<triplet>& entries, std::size_t first, std::size_t last,
+                           std::size_t row_begin, std::size_t row_end){
+        panel_info info;
+        info.row_begin = row_begin;
+        info.row_end = row_end;
+        info.nnz = last - first;
+        info.offset = static_cast<std::uint64_t>(out.tellp());
+
+        std::vector<std::size_t> outer_start(row_end - row_begin + 1, 0);
+        std::vector<std::size_t> inner_indices(last - first);
+        std::vector<T> panel_values(last - first);
+        for (std::size_t idx = first; idx < last; ++idx){
+            outer_start[entries[idx].row - row_begin + 1]++;  // count all entries for each row
+            inner_indices[idx - first] = entries[idx].col;
+            panel_values[idx - first] = entries[idx].value;
+        }
+        for (std::size_t r = 1; r < outer_start.size(); ++r){
+            outer_start[r] += outer_start[r - 1];  // Cumulative sum to get the start index of each row
+        }
+
+        out.write(reinterpret_cast<const char*>(outer_start.data()), outer_start.size() * sizeof(std::size_t));
+        out.write(reinterpret_cast<const char*>(inner_indices.data()), inner_indices.size() * sizeof(std::size_t));
+        out.write(reinterpret_cast<const char*>(panel_values.data()), panel_values.size() * sizeof(T));
+        panels.push_back(info);
+        total_nnz += info.nnz;
+    };
+
+    // Write the panel of a single row whose entries cannot be loaded at once. The entries are
+    // split by column ranges until a range fits in memory_budget, ranges are sorted in column
+    // order, the column indices are written straight to the panel and the values to a side
+    // file appended to the panel at the end. Only the panel itself must fit in panel_budget.
+    auto write_long_row = [&](const bucket& current){
+        panel_info info;
+        info.row_begin = current.row_begin;
+        info.row_end = current.row_end;
+        info.offset = static_cast<std::uint64_t>(out.tellp());
+        std::size_t outer_start[2] = {0, 0};  // rewritten once the number of entries is known
+        out.write(reinterpret_cast<const char*>(outer_start), sizeof(outer_start));
+
+        std::string values_name = new_bucket();
+        std::ofstream values_out(values_name, std::ios::binary | std::ios::trunc);
+        std::size_t count = 0;
+        auto emit = [&](const triplet& entry){
+            std::size_t col = entry.col;
+            out.write(reinterpret_cast<const char*>(&col), sizeof(col));
+            values_out.write(reinterpret_cast<const char*>(&entry.value), sizeof(T));
+            ++count;
+        };
+
+        // Column ranges still to process, the last one is the next in column order
+        struct column_range{
+            std::string name;
+            std::size_t col_begin;
+            std::size_t col_end;
+        };
+        std::vector<column_range> ranges{{current.name, 0, cols}};
+        while (!ranges.empty()){
+            column_range range = ranges.back();
+            ranges.pop_back();
+            std::size_t bytes;
+            {
+                std::ifstream in(range.name, std::ios::binary | std::ios::ate);
+                bytes = static_cast<std::size_t>(in.tellg());
+            }
+            std::size_t range_cols = range.col_end - range.col_begin;
+
+            if (bytes > memory_budget && range_cols == 1){
+                // Duplicates of a single entry, the last one read is kept
+                std::ifstream in(range.name, std::ios::binary);
+                triplet entry;
+                triplet last{0, 0, 0, T()};
+                while (in.read(reinterpret_cast<char*>(&entry), sizeof(triplet))){
+                    if (entry.seq >= last.seq){
+                        last = entry;
+                    }
+                }
+                emit(last);
+            }
+            else if (bytes > memory_budget){
+                // Split the columns in sub-ranges, streaming the entries through bounded buffers
+                std::size_t parts = std::min(range_cols, 2 * ((bytes + memory_budget - 1) / memory_budget));
+                std::size_t sub_cols = (range_cols + parts - 1) / parts;
+                parts = (range_cols + sub_cols - 1) / sub_cols;
+                std::size_t sub_capacity = std::max<std::size_t>(1, panel_budget / (parts * sizeof(triplet)));
+
+                std::vector<column_range> subs(parts);
+                for (std::size_t b = 0; b < parts; ++b){
+                    subs[b] = {new_bucket(), range.col_begin + b * sub_cols, std::min(range.col_end, range.col_begin + (b + 1) * sub_cols)};
+                }
+                std::vector<std::vector<triplet>> sub_buffers(parts);
+                for (auto& buffer : sub_buffers){
+                    buffer.reserve(sub_capacity);
+                }
+                {
+                    std::ifstream in(range.name, std::ios::binary);
+                    triplet entry;
+                    while (in.read(reinterpret_cast<char*>(&entry), sizeof(triplet))){
+                        std::size_t b = (entry.col - range.col_begin) / sub_cols;
+                        sub_buffers[b].push_back(entry);
+                        if (sub_buffers[b].size() >= sub_capacity){
+                            flush(sub_buffers[b], subs[b].name);
+                        }
+                    }
+                }
+                for (std::size_t b = 0; b < parts; ++b){
+                    flush(sub_buffers[b], subs[b].name);
+                }
+                for (std::size_t b = parts; b-- > 0;){
+                    ranges.push_back(subs[b]);
+                }
+            }
+            else{
+                // Load the range, sort it by column and keep the last of duplicated entries
+                std::vector<triplet> entries(bytes / sizeof(triplet));
+                {
+                    std::ifstream in(range.name, std::ios::binary);
+                    in.read(reinterpret_cast<char*>(entries.data()), bytes);
+                }
+                std::sort(entries.begin(), entries.end(), [](const triplet& a, const triplet& c){
+                    return a.col < c.col || (a.col == c.col && a.seq < c.seq);
+                });
+                for (std::size_t idx = 0; idx < entries.size(); ++idx){
+                    if (idx + 1 == entries.size() || entries[idx + 1].col != entries[idx].col){
+                        emit(entries[idx]);
+                    }
+                }
+            }
+            std::remove(range.name.c_str());
+        }
+        values_out.close();
+        if (!values_out){
+            throw std::runtime_error("cannot write bucket file");
+        }
+        if (panel_bytes<T>(1, count) > panel_budget){
+            throw std::runtime_error("Row does not fit in the memory budget");
+        }
+
+        // Append the values in bounded chunks
+        {
+            std::ifstream in(values_name, std::ios::binary);
+            std::vector<char> chunk(std::min<std::size_t>(panel_budget, std::size_t(1) << 16));
+            while (in.read(chunk.data(), chunk.size()) || in.gcount() > 0){
+                out.write(chunk.data(), in.gcount());
+            }
+        }
+        std::remove(values_name.c_str());
+
+        // Rewrite the row offsets now that the number of entries is known
+        std::uint64_t end = static_cast<std::uint64_t>(out.tellp());
+        outer_start[1] = count;
+        out.seekp(info.offset);
+        out.write(reinterpret_cast<const char*>(outer_start), sizeof(outer_start));
+        out.seekp(end);
+
+        info.nnz = count;
+        panels.push_back(info);
+        total_nnz += count;
+    };
+
+    // Buckets are processed in row order. A loaded bucket and the panel being written from it
+    // (at most panel_budget bytes) must fit in memory_budget, larger buckets are split.
+    while (!pending.empty()){
+        bucket current = pending.back();
+        pending.pop_back();
+
+        std::size_t bytes;
+        {
+            std::ifstream in(current.name, std::ios::binary | std::ios::ate);
+            bytes = static_cast<std::size_t>(in.tellg());
+        }
+
+        // The loaded triplets and the compressed copy of the panel being written must fit in the budget
+        std::size_t bucket_rows = current.row_end - current.row_begin;
+        std::size_t csr_bytes = std::min(panel_budget, panel_bytes<T>(bucket_rows, bytes / sizeof(triplet)));
+        if (bytes + csr_bytes > memory_budget){
+            if (bucket_rows == 1){
+                write_long_row(current);
+                continue;
+            }
+            // Split the rows in sub-buckets, streaming the entries through bounded buffers
+            std::size_t parts = std::min(bucket_rows, 2 * ((bytes + panel_budget - 1) / panel_budget));
+            std::size_t sub_rows = (bucket_rows + parts - 1) / parts;
+            parts = (bucket_rows + sub_rows - 1) / sub_rows;
+            std::size_t sub_capacity = std::max<std::size_t>(1, panel_budget / (parts * sizeof(triplet)));
+
+            std::vector<bucket> subs(parts);
+            for (std::size_t b = 0; b < parts; ++b){
+                subs[b] = {new_bucket(), current.row_begin + b * sub_rows, std::min(current.row_end, current.row_begin + (b + 1) * sub_rows)};
+            }
+            std::vector<std::vector<triplet>> sub_buffers(parts);
+            for (auto& buffer : sub_buffers){
+                buffer.reserve(sub_capacity);
+            }
+            {
+                std::ifstream in(current.name, std::ios::binary);
+                triplet entry;
+                while (in.read(reinterpret_cast<char*>(&entry), sizeof(triplet))){
+                    std::size_t b = (entry.row - current.row_begin) / sub_rows;
+                    sub_buffers[b].push_back(entry);
+                    if (sub_buffers[b].size() >= sub_capacity){
+                        flush(sub_buffers[b], subs[b].name);
+                    }
+                }
+            }
+            for (std::size_t b = 0; b < parts; ++b){
+                flush(sub_buffers[b], subs[b].name);
+            }
+            std::remove(current.name.c_str());
+            for (std::size_t b = parts; b-- > 0;){
+                pending.push_back(subs[b]);
+            }
+            continue;
+        }
+
+        // Load the bucket
+        std::vector<triplet> entries(bytes / sizeof(triplet));
+        {
+            std::ifstream in(current.name, std::ios::binary);
+            in.read(reinterpret_cast<char*>(entries.data()), bytes);
+        }
+        std::remove(current.name.c_str());
+
+        // Sort in row-major order, a duplicated entry keeps the last value read like insert() does
+        std::sort(entries.begin(), entries.end(), [](const triplet& a, const triplet& c){
+            return (a.row < c.row) || (a.row == c.row && (a.col < c.col || (a.col == c.col && a.seq < c.seq)));
+        });
+        std::size_t unique = 0;
+        for (std::size_t idx = 0; idx < entries.size(); ++idx){
+            if (unique > 0 && entries[unique - 1].row == entries[idx].row && entries[unique - 1].col == entries[idx].col){
+                entries[unique - 1] = entries[idx];
+            }
+            else{
+                entries[unique++] = entries[idx];
+            }
+        }
+        entries.resize(unique);
+
+        // Cut the bucket into panels at row boundaries
+        std::size_t panel_row_begin = current.row_begin;
+        std::size_t panel_first = 0;
+        std::size_t idx = 0;
+        while (idx < entries.size()){
+            std::size_t row = entries[idx].row;
+            std::size_t row_last = idx;
+            while (row_last < entries.size() && entries[row_last].row == row){
+                ++row_last;
+            }
+            if (panel_bytes<T>(1, row_last - idx) > panel_budget){
+                throw std::runtime_error("Row does not fit in the memory budget");
+            }
+            // Close the current panel if adding this row exceeds the budget
+            if (panel_bytes<T>(row + 1 - panel_row_begin, row_last - panel_first) > panel_budget){
+                if (panel_first < idx){
+                    write_panel(entries, panel_first, idx, panel_row_begin, row);
+                    panel_first = idx;
+                }
+                panel_row_begin = row;  // leading empty rows are left out of the panel
+            }
+            idx = row_last;
+        }
+        if (panel_first < entries.size()){
+            std::size_t panel_row_end = entries.back().row + 1;
+            if (panel_bytes<T>(current.row_end - panel_row_begin, entries.size() - panel_first) <= panel_budget){
+                panel_row_end = current.row_end;  // cover the trailing empty rows when it fits
+            }
+            write_panel(entries, panel_first, entries.size(), panel_row_begin, panel_row_end);
+        }
+    }
+
+    // Write the panel index table and the final header
+    header.value_size = sizeof(T);
+    header.rows = rows;
+    header.cols = cols;
+    header.nnz = total_nnz;
+    header.num_panels = panels.size();
+    header.index_offset = static_cast<std::uint64_t>(out.tellp());
+    out.write(reinterpret_cast<const char*>(panels.data()), panels.size() * sizeof(panel_info));
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!out){
+        throw std::runtime_error("cannot write panel file");
+    }
+}
+
+// Disk-resident row-major matrix partitioned in compressed row panels.
+// Products stream the panels sequentially, the next panel is loaded asynchronously
+// while the current one is being computed, so at most two panels live in memory.
+template<typename T>
+class panel_matrix{
+    private:
+    std::string file_name;  // Panel file
+    panel_file_header header;  // Dimensions and layout of the file
+    std::vector<panel_info> panels;  // Panel index table
+    std::size_t memory_budget = 0;  // Maximum bytes used by resident panels
+
+    // Check that two panels fit in the memory budget
+    void check_budget() const{
+        for (const auto& info : panels){
+            if (2 * panel_bytes<T>(info.row_end - info.row_begin, info.nnz) > memory_budget){
+                throw std::invalid_argument("Panel does not fit in the memory budget");
+            }
+        }
+    }
+
+    // Read a panel from the file
+    row_panel<T> load_panel(std::ifstream& file, std::size_t k) const{
+        const panel_info& info = panels[k];
+        row_panel<T> panel;
+        panel.row_begin = info.row_begin;
+        panel.row_end = info.row_end;
+        panel.outer_start.resize(info.row_end - info.row_begin + 1);
+        panel.inner_indices.resize(info.nnz);
+        panel.values.resize(info.nnz);
+
+        file.seekg(info.offset);
+        file.read(reinterpret_cast<char*>(panel.outer_start.data()), panel.outer_start.size() * sizeof(std::size_t));
+        file.read(reinterpret_cast<char*>(panel.inner_indices.data()), panel.inner_indices.size() * sizeof(std::size_t));
+        file.read(reinterpret_cast<char*>(panel.values.data()), panel.values.size() * sizeof(T));
+        if (!file){
+            throw std::runtime_error("cannot read panel");
+        }
+        return panel;
+    }
+
+    public:
+
+    // Limit to arithmetic or complex types
+    static_assert(is_arithmetic_or_complex<T>::value, "Matrix can only be of arithmetic or complex types");
+
+    // Constructor, opens a file written by convert_mtx_to_panels
+    panel_matrix(const std::string& name, std::size_t budget):
+     file_name(name), memory_budget(budget) {
+
+        std::ifstream file(file_name, std::ios::binary);
+        if (!file.is_open()){
+            throw std::runtime_error("file is not open");
+        }
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!file || std::memcmp(header.magic, panel_magic, sizeof(panel_magic)) != 0){
+            throw std::runtime_error("not a panel file");
+        }
+        if (header.value_size != sizeof(T)){
+            throw std::runtime_error("Panel file value type does not match");
+        }
+        panels.resize(header.num_panels);
+        file.seekg(header.index_offset);
+        file.read(reinterpret_cast<char*>(panels.data()), panels.size() * sizeof(panel_info));
+        if (!file){
+            throw std::runtime_error("cannot read panel index");
+        }
+        check_budget();
+    }
+
+    // Get number of rows
+    std::size_t get_rows() const {
+        return header.rows;
+    }
+
+    // Get number of columns
+    std::size_t get_cols() const {
+        return header.cols;
+    }
+
+    // Get the number of non-zero elements
+    std::size_t get_nnz() const {
+        return header.nnz;
+    }
+
+    // Get the number of panels
+    std::size_t get_num_panels() const {
+        return panels.size();
+    }
+
+    // Get the memory budget
+    std::size_t get_memory_budget() const {
+        return memory_budget;
+    }
+
+    // Set the memory budget
+    void set_memory_budget(std::size_t budget){
+        std::size_t old_budget = memory_budget;
+        memory_budget = budget;
+        try{
+            check_budget();
+        }
+        catch (...){
+            memory_budget = old_budget;
+            throw;
+        }
+    }
+
+    // Apply kernel to every panel in order, prefetching the next panel in the background
+    template<typename Kernel>
+    void stream(Kernel&& kernel) const{
+        if (panels.empty()){
+            return;
+        }
+        std::ifstream file(file_name, std::ios::binary);
+        if (!file.is_open()){
+            throw std::runtime_error("file is not open");
+        }
+        std::future<row_panel<T>> next = std::async(std::launch::async, [this, &file]{ return load_panel(file, 0); });
+        for (std::size_t k = 0; k < panels.size(); ++k){
+            row_panel<T> current = next.get();
+            if (k + 1 < panels.size()){
+                next = std::async(std::launch::async, [this, &file, k]{ return load_panel(file, k + 1); });
+            }
+            kernel(static_cast<const row_panel<T>&>(current));
+        }
+    }
+
+    // Multiplication with a vector
+    template<typename T2>
+    requires is_arithmetic_or_complex<T2>::value
+    auto multiply(const std::vector<T2>& vec) const{
+        static_assert(std::is_convertible_v<T, T2> || std::is_convertible_v<T2, T>, "Matrix and vector types must be compatible");
+        if (get_cols() != vec.size()){
+            throw std::invalid_argument("Matrix and vector dimensions do not match");
+        }
+
+        using result_type = std::common_type_t<T, T2>;
+        std::vector<result_type> result(get_rows(), result_type{});
+
+        stream([&](const row_panel<T>& panel){
+            for (std::size_t r = 0; r + panel.row_begin < panel.row_end; ++r){
+                result_type sum = result_type{};
+                // loop over the non-zero values in the current row
+                for (std::size_t idx = panel.outer_start[r]; idx < panel.outer_start[r + 1]; ++idx){
+                    sum += static_cast<result_type>(panel.values[idx]) * vec[panel.inner_indices[idx]];
+                }
+                result[panel.row_begin + r] = sum;
+            }
+        });
+        return result;
+    }
+
+    // Multiplication with several vectors, every panel is read once for all of them
+    template<typename T2>
+    requires is_arithmetic_or_complex<T2>::value
+    auto multiply(const std::vector<std::vector<T2>>& vecs) const{
+        static_assert(std::is_convertible_v<T, T2> || std::is_convertible_v<T2, T>, "Matrix and vector types must be compatible");
+        for (const auto& vec : vecs){
+            if (get_cols() != vec.size()){
+                throw std::invalid_argument("Matrix and vector dimensions do not match");
+            }
+        }
+
+        using result_type = std::common_type_t<T, T2>;
+        std::vector<std::vector<result_type>> result(vecs.size(), std::vector<result_type>(get_rows(), result_type{}));
+
+        stream([&](const row_panel<T>& panel){
+            for (std::size_t r = 0; r + panel.row_begin < panel.row_end; ++r){
+                std::size_t row = panel.row_begin + r;
+                // loop over the non-zero values in the current row
+                for (std::size_t idx = panel.outer_start[r]; idx < panel.outer_start[r + 1]; ++idx){
+                    std::size_t col = panel.inner_indices[idx];
+                    result_type value = panel.values[idx];
+                    // loop over the vectors
+                    for (std::size_t v = 0; v < vecs.size(); ++v){
+                        result[v][row] += value * vecs[v][col];
+                    }
+                }
+            }
+        });
+        return result;
+    }
+};
+
+// Multiplication operator for panel matrix and std::vector
+template<typename T1, typename T2>
+requires is_arithmetic_or_complex<T1>::value && is_arithmetic_or_complex<T2>::value  // limitation to arithmetic or complex types
+auto operator*(const panel_matrix<T1>& Mat, const std::vector<T2>& vec){
+    return Mat.multiply(vec);
+}
+
+}
+
+#endif
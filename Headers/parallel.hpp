@@ -0,0 +1,176 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace algebra {
+
+// Number of threads used when none is given
+inline std::size_t default_num_threads(){
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Persistent pool of worker threads shared by all the parallel loops.
+// The workers are started on first use and joined at program exit.
+class thread_pool{
+    private:
+    std::mutex pool_mutex;
+    std::condition_variable pool_cv;
+    std::deque<std::function<void()>> tasks;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+
+    // Worker loop
+    void run(){
+        while (true){
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(pool_mutex);
+                pool_cv.wait(lock, [this]{ return stopping || !tasks.empty(); });
+                if (tasks.empty()){
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    public:
+    // Constructor, the calling thread takes part in every loop so one worker less is started
+    explicit thread_pool(std::size_t num_workers){
+        for (std::size_t t = 0; t < num_workers; ++t){
+            workers.emplace_back([this]{ run(); });
+        }
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    // Destructor, stops the workers
+    ~thread_pool(){
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            stopping = true;
+        }
+        pool_cv.notify_all();
+        for (auto& worker : workers){
+            worker.join();
+        }
+    }
+
+    // Pool used by parallel_for
+    static thread_pool& instance(){
+        static thread_pool pool(default_num_threads() - 1);
+        return pool;
+    }
+
+    // Queue a task, tasks must not throw
+    void push(std::function<void()> task){
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            tasks.push_back(std::move(task));
+        }
+        pool_cv.notify_one();
+    }
+
+    // Run one queued task on the calling thread, false if there was none
+    bool try_run_one(){
+        std::function<void()> task;
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            if (tasks.empty()){
+                return false;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+        return true;
+    }
+};
+
+// Run func(begin, end) on contiguous chunks of [0, n), one chunk per thread.
+// Each chunk holds at least grain indices so small ranges run on the calling thread.
+// Chunks are handed to the persistent thread_pool, so a call costs a few queue operations
+// instead of creating threads. The calling thread runs the first chunk and then helps with
+// queued chunks while it waits, which keeps nested or concurrent loops from deadlocking.
+template<typename Func>
+void parallel_for(std::size_t n, Func&& func, std::size_t num_threads = 0, std::size_t grain = 1024){
+    if (grain == 0){
+        throw std::invalid_argument("Grain size must be positive");
+    }
+    if (num_threads == 0){
+        num_threads = default_num_threads();
+    }
+    num_threads = std::min(num_threads, (n + grain - 1) / grain);
+    if (num_threads <= 1){
+        func(std::size_t(0), n);
+        return;
+    }
+
+    std::vector<std::exception_ptr> errors(num_threads);
+    std::size_t chunk = (n + num_threads - 1) / num_threads;
+    auto run_chunk = [&func, &errors, chunk, n](std::size_t t){
+        std::size_t begin = std::min(n, t * chunk);
+        std::size_t end = std::min(n, begin + chunk);
+        try{
+            func(begin, end);
+        }
+        catch (...){
+            errors[t] = std::current_exception();
+        }
+    };
+
+    // Chunks still running, the last one to finish wakes up the calling thread
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    std::size_t remaining = num_threads - 1;
+    thread_pool& pool = thread_pool::instance();
+    for (std::size_t t = 1; t < num_threads; ++t){
+        pool.push([&, t]{
+            run_chunk(t);
+            std::lock_guard<std::mutex> lock(done_mutex);
+            if (--remaining == 0){
+                done_cv.notify_one();
+            }
+        });
+    }
+    run_chunk(0);
+
+    while (true){
+        {
+            std::lock_guard<std::mutex> lock(done_mutex);
+            if (remaining == 0){
+                break;
+            }
+        }
+        if (!pool.try_run_one()){
+            // Every chunk left has been taken by a worker
+            std::unique_lock<std::mutex> lock(done_mutex);
+            done_cv.wait(lock, [&remaining]{ return remaining == 0; });
+            break;
+        }
+    }
+
+    // Rethrow the first exception raised by a chunk
+    for (auto& error : errors){
+        if (error){
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+}
+
+#endif
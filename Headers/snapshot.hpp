@@ -0,0 +1,153 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include "matrix.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+// Immutable versions of a compressed matrix shared between concurrent readers and a writer.
+// The writer builds a new matrix off to the side and publishes it atomically, readers keep
+// using the version they hold while the rebuild runs. A version is destroyed when the last
+// shared_ptr referring to it is released.
+
+namespace algebra {
+
+// Immutable compressed matrix tagged with a version number
+template<typename T, StorageOrder order>
+class matrix_snapshot{
+    private:
+    matrix<T, order> mat;  // Compressed matrix, never modified after construction
+    std::uint64_t version = 0;  // Version number given by the handle
+
+    public:
+    // Constructor, the matrix is compressed if needed
+    matrix_snapshot(matrix<T, order> m, std::uint64_t v):
+     mat(std::move(m)), version(v) {
+        if (!mat.is_compressed()){
+            mat.compress();
+        }
+    }
+
+    // Snapshots are not copied, they are shared through std::shared_ptr
+    matrix_snapshot(const matrix_snapshot&) = delete;
+    matrix_snapshot& operator=(const matrix_snapshot&) = delete;
+
+    // Get the compressed matrix
+    const matrix<T, order>& get_matrix() const{
+        return mat;
+    }
+
+    // Get the version number
+    std::uint64_t get_version() const{
+        return version;
+    }
+
+    // Get number of rows
+    std::size_t get_rows() const{
+        return mat.get_rows();
+    }
+
+    // Get number of columns
+    std::size_t get_cols() const{
+        return mat.get_cols();
+    }
+
+    // Get the number of non-zero elements
+    std::size_t get_nnz() const{
+        return mat.get_nnz();
+    }
+};
+
+// Multiplication of a snapshot with a std::vector
+template<typename T1, StorageOrder ord, typename T2>
+requires is_arithmetic_or_complex<T1>::value && is_arithmetic_or_complex<T2>::value  // limitation to arithmetic or complex types
+auto operator*(const matrix_snapshot<T1, ord>& snap, const std::vector<T2>& vec){
+    return snap.get_matrix() * vec;
+}
+
+// Handle to the current snapshot of a matrix, readers load it atomically while a writer publishes new versions
+template<typename T, StorageOrder order>
+class snapshot_handle{
+    public:
+    using snapshot_type = matrix_snapshot<T, order>;
+    using snapshot_ptr = std::shared_ptr<const snapshot_type>;
+
+    private:
+    std::atomic<snapshot_ptr> current;  // Current snapshot, libstdc++ guards it with a short internal lock
+    std::atomic<std::uint64_t> version{0};  // Version of the current snapshot, updated after current
+    std::mutex write_mutex;  // Serializes writers, never taken by readers
+
+    public:
+    // Default constructor, nothing is published
+    snapshot_handle() = default;
+
+    // Constructor publishing a first version
+    explicit snapshot_handle(matrix<T, order> m){
+        publish(std::move(m));
+    }
+
+    snapshot_handle(const snapshot_handle&) = delete;
+    snapshot_handle& operator=(const snapshot_handle&) = delete;
+
+    // Get the current snapshot, it stays valid as long as the returned pointer is held.
+    // The load briefly takes the internal lock of the atomic shared_ptr and bumps the reference count.
+    snapshot_ptr load() const{
+        return current.load(std::memory_order_acquire);
+    }
+
+    // Get the version of the current snapshot, 0 if nothing is published
+    std::uint64_t get_version() const{
+        return version.load(std::memory_order_acquire);
+    }
+
+    // Publish a new version of the matrix, returns its version number
+    std::uint64_t publish(matrix<T, order> m){
+        std::lock_guard<std::mutex> lock(write_mutex);
+        std::uint64_t new_version = version.load(std::memory_order_relaxed) + 1;
+        // Compression happens here, before the snapshot becomes visible
+        snapshot_ptr snap = std::make_shared<const snapshot_type>(std::move(m), new_version);
+        current.store(std::move(snap), std::memory_order_release);
+        version.store(new_version, std::memory_order_release);
+        return new_version;
+    }
+};
+
+// Per-thread reader caching the snapshot it uses.
+// In the steady state acquire() is a single atomic load of the version counter; the shared
+// snapshot pointer is loaded again, through the brief internal lock of load(), only when
+// the version changes.
+template<typename T, StorageOrder order>
+class snapshot_reader{
+    public:
+    using snapshot_type = matrix_snapshot<T, order>;
+
+    private:
+    const snapshot_handle<T, order>& handle;
+    std::shared_ptr<const snapshot_type> cached;  // Snapshot in use by this reader
+
+    public:
+    // Constructor
+    snapshot_reader(const snapshot_handle<T, order>& h): handle(h) {}
+
+    // Get the current snapshot, valid until the next call to acquire() or release()
+    const snapshot_type& acquire(){
+        if (!cached || cached->get_version() != handle.get_version()){
+            cached = handle.load();
+            if (!cached){
+                throw std::runtime_error("No snapshot published");
+            }
+        }
+        return *cached;
+    }
+
+    // Drop the cached snapshot so that it can be reclaimed
+    void release(){
+        cached.reset();
+    }
+};
+
+}
+
+#endif
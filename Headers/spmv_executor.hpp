@@ -0,0 +1,293 @@
+#ifndef SPMV_EXECUTOR_HPP
+#define SPMV_EXECUTOR_HPP
+
+#include "matrix.hpp"
+#include "parallel.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+
+// Asynchronous executor coalescing independent matrix-vector products into multi-vector sweeps.
+// Requests are queued until max_batch of them are waiting or the oldest one has waited
+// max_latency, then a worker multiplies the whole batch with a single pass over the
+// compressed matrix and hands back the individual results.
+
+namespace algebra {
+
+// Multiply a compressed matrix with nvec vectors stored in a dense block,
+// x[j * nvec + v] is the j-th element of vector v and the result is stored the same way in y
+template<typename T, StorageOrder order>
+void multiply_block(const matrix<T, order>& mat, const T* x, T* y, std::size_t nvec, std::size_t num_threads = 0){
+    if (!mat.is_compressed()){
+        throw std::runtime_error("Matrix must be compressed");
+    }
+    const auto& outer_start = mat.get_outer_start();
+    const auto& inner_indices = mat.get_inner_indices();
+    const auto& values = mat.get_values();
+
+    if constexpr (order == StorageOrder::row_major){
+        // Rows are independent, parallelize over them
+        parallel_for(mat.get_rows(), [&](std::size_t begin, std::size_t end){
+            for (std::size_t i = begin; i < end; ++i){
+                T* y_row = y + i * nvec;
+                std::fill(y_row, y_row + nvec, T());
+                // loop over the non-zero values in the current row
+                for (std::size_t idx = outer_start[i]; idx < outer_start[i + 1]; ++idx){
+                    const T value = values[idx];
+                    const T* x_row = x + inner_indices[idx] * nvec;
+                    // loop over the vectors, contiguous in memory
+                    for (std::size_t v = 0; v < nvec; ++v){
+                        y_row[v] += value * x_row[v];
+                    }
+                }
+            }
+        }, num_threads);
+    }
+    else{
+        // Columns scatter into the same rows, computed sequentially
+        std::fill(y, y + mat.get_rows() * nvec, T());
+        for (std::size_t j = 0; j < mat.get_cols(); ++j){
+            const T* x_row = x + j * nvec;
+            // loop over the non-zero values in the current column
+            for (std::size_t idx = outer_start[j]; idx < outer_start[j + 1]; ++idx){
+                const T value = values[idx];
+                T* y_row = y + inner_indices[idx] * nvec;
+                for (std::size_t v = 0; v < nvec; ++v){
+                    y_row[v] += value * x_row[v];
+                }
+            }
+        }
+    }
+}
+
+// Configuration of the executor
+struct executor_config{
+    std::size_t max_batch = 8;  // Maximum number of vectors multiplied together
+    std::chrono::microseconds max_latency{100};  // Maximum time a request waits for a batch to fill
+    std::size_t num_workers = 1;  // Number of threads running batches
+    std::size_t kernel_threads = 1;  // Number of threads used by each batch multiplication
+};
+
+// Statistics collected by the executor
+struct executor_stats{
+    std::size_t requests = 0;  // Completed requests
+    std::size_t batches = 0;  // Executed batches
+    double mean_batch_size = 0;  // Average number of vectors per batch
+    double throughput = 0;  // Completed requests per second since the executor started
+    double mean_latency_us = 0;  // Average time between submission and completion
+    double max_latency_us = 0;  // Largest time between submission and completion
+    std::size_t callback_errors = 0;  // Completion callbacks that threw, their exceptions are dropped
+};
+
+template<typename T, StorageOrder order>
+class spmv_executor{
+    public:
+    // Completion callback, error is set if the multiplication failed
+    using callback_type = std::function<void(std::vector<T> result, std::exception_ptr error)>;
+
+    private:
+    using clock = std::chrono::steady_clock;
+
+    // Pending request
+    struct request{
+        std::vector<T> vec;
+        callback_type done;
+        clock::time_point submitted;
+    };
+
+    const matrix<T, order>& mat;  // Compressed matrix, must not be modified while the executor runs
+    executor_config config;
+    std::deque<request> queue;  // Pending requests, oldest first
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+
+    // Statistics
+    mutable std::mutex stats_mutex;
+    clock::time_point start_time;
+    std::size_t completed = 0;
+    std::size_t batches = 0;
+    double total_latency_us = 0;
+    double max_latency_us = 0;
+    std::size_t callback_errors = 0;
+
+    // Worker loop, waits for a full batch or the deadline of the oldest request
+    void run(){
+        std::vector<request> batch;
+        std::vector<T> x;
+        std::vector<T> y;
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        while (true){
+            queue_cv.wait(lock, [this]{ return stopping || !queue.empty(); });
+            if (queue.empty()){
+                return;  // stopping and nothing left to do
+            }
+            clock::time_point deadline = queue.front().submitted + config.max_latency;
+            queue_cv.wait_until(lock, deadline, [this]{ return stopping || queue.size() >= config.max_batch; });
+            if (queue.empty()){
+                continue;  // taken by another worker
+            }
+
+            std::size_t nvec = std::min(config.max_batch, queue.size());
+            for (std::size_t v = 0; v < nvec; ++v){
+                batch.push_back(std::move(queue.front()));
+                queue.pop_front();
+            }
+            lock.unlock();
+
+            process(batch, x, y);
+            batch.clear();
+
+            lock.lock();
+        }
+    }
+
+    // Multiply a batch of vectors and complete the requests
+    void process(std::vector<request>& batch, std::vector<T>& x, std::vector<T>& y){
+        std::size_t nvec = batch.size();
+        std::size_t rows = mat.get_rows();
+        std::size_t cols = mat.get_cols();
+        std::exception_ptr error;
+        try{
+            // Interleave the vectors so that the sweep reads them contiguously
+            x.resize(cols * nvec);
+            y.resize(rows * nvec);
+            for (std::size_t v = 0; v < nvec; ++v){
+                for (std::size_t j = 0; j < cols; ++j){
+                    x[j * nvec + v] = batch[v].vec[j];
+                }
+            }
+            multiply_block(mat, x.data(), y.data(), nvec, config.kernel_threads);
+        }
+        catch (...){
+            error = std::current_exception();
+        }
+
+        clock::time_point now = clock::now();
+        double batch_latency_us = 0;
+        double batch_max_us = 0;
+        std::size_t batch_callback_errors = 0;
+        for (std::size_t v = 0; v < nvec; ++v){
+            std::vector<T> result;
+            if (!error){
+                result = std::move(batch[v].vec);  // reuse the request storage when sizes match
+                result.resize(rows);
+                for (std::size_t i = 0; i < rows; ++i){
+                    result[i] = y[i * nvec + v];
+                }
+            }
+            double latency = std::chrono::duration<double, std::micro>(now - batch[v].submitted).count();
+            batch_latency_us += latency;
+            batch_max_us = std::max(batch_max_us, latency);
+            // A throwing callback must not stop the worker nor the other requests of the batch,
+            // its exception is dropped and counted in the statistics
+            try{
+                batch[v].done(std::move(result), error);
+            }
+            catch (...){
+                batch_callback_errors++;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        completed += nvec;
+        batches++;
+        total_latency_us += batch_latency_us;
+        max_latency_us = std::max(max_latency_us, batch_max_us);
+        callback_errors += batch_callback_errors;
+    }
+
+    public:
+
+    // Constructor, starts the workers
+    spmv_executor(const matrix<T, order>& m, executor_config c = {}):
+     mat(m), config(c), start_time(clock::now()) {
+        if (!mat.is_compressed()){
+            throw std::runtime_error("Matrix must be compressed");
+        }
+        if (config.max_batch == 0 || config.num_workers == 0){
+            throw std::invalid_argument("Batch size and number of workers must be positive");
+        }
+        for (std::size_t t = 0; t < config.num_workers; ++t){
+            workers.emplace_back([this]{ run(); });
+        }
+    }
+
+    spmv_executor(const spmv_executor&) = delete;
+    spmv_executor& operator=(const spmv_executor&) = delete;
+
+    // Destructor, completes the pending requests and stops the workers
+    ~spmv_executor(){
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            stopping = true;
+        }
+        queue_cv.notify_all();
+        for (auto& worker : workers){
+            worker.join();
+        }
+    }
+
+    // Submit a multiplication, the callback is called by a worker thread.
+    // Exceptions thrown by the callback are dropped and counted in executor_stats::callback_errors.
+    void submit(std::vector<T> vec, callback_type done){
+        // Check if the dimensions of the matrix and vector match
+        if (vec.size() != mat.get_cols()){
+            throw std::invalid_argument("Matrix and vector dimensions do not match");
+        }
+        bool full;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            queue.push_back({std::move(vec), std::move(done), clock::now()});
+            full = queue.size() >= config.max_batch;
+        }
+        if (full){
+            queue_cv.notify_all();
+        }
+        else{
+            queue_cv.notify_one();
+        }
+    }
+
+    // Submit a multiplication, the result is delivered through a future
+    std::future<std::vector<T>> submit(std::vector<T> vec){
+        auto promise = std::make_shared<std::promise<std::vector<T>>>();
+        std::future<std::vector<T>> result = promise->get_future();
+        submit(std::move(vec), [promise](std::vector<T> res, std::exception_ptr error){
+            if (error){
+                promise->set_exception(error);
+            }
+            else{
+                promise->set_value(std::move(res));
+            }
+        });
+        return result;
+    }
+
+    // Get the statistics collected so far
+    executor_stats get_stats() const{
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        executor_stats stats;
+        stats.requests = completed;
+        stats.batches = batches;
+        stats.max_latency_us = max_latency_us;
+        stats.callback_errors = callback_errors;
+        if (batches > 0){
+            stats.mean_batch_size = static_cast<double>(completed) / batches;
+            stats.mean_latency_us = total_latency_us / completed;
+        }
+        double elapsed = std::chrono::duration<double>(clock::now() - start_time).count();
+        if (elapsed > 0){
+            stats.throughput = completed / elapsed;
+        }
+        return stats;
+    }
+};
+
+}
+
+#endif
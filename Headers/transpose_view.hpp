@@ -14,6 +14,11 @@ class transpose_view{
         // Constructor
         transpose_view(const matrix<T, order>& m): mat(m) {}
 
+        // Get the underlying matrix
+        const matrix<T, order>& get_matrix() const{
+            return mat;
+        }
+
         // Number of rows
         std::size_t get_rows() const{
             return mat.get_cols();
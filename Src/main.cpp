@@ -1,6 +1,15 @@
 #include "matrix.hpp"
 #include "diagonal_view.hpp"
 #include "transpose_view.hpp"
+#include "panel_matrix.hpp"
+#include "expression.hpp"
+#include "matrix_operations.hpp"
+#include "snapshot.hpp"
+#include "spmv_executor.hpp"
+#include "numa_matrix.hpp"
+#include "matrix_powers.hpp"
+#include <thread>
+#include <cmath>
 #include <chrono>
 
 using namespace algebra;
@@ -92,6 +101,247 @@ int main(){
     std::cout << "Time taken for multiplication with uncompressed column matrix: " << duration3.count() << " µs" << std::endl;
     std::cout << "Time taken for multiplication with compressed column matrix: " << duration4.count() << " µs" << std::endl;
 
+    // Testing out-of-core panel matrix with a small memory budget to get several panels
+    convert_mtx_to_panels<double>("./Data/lnsp_131.mtx", "./Data/lnsp_131.panels", 8192);
+    panel_matrix<double> mat6("./Data/lnsp_131.panels", 8192);
+    std::cout << "Matrix 6 dimensions: " << mat6.get_rows() << " x " << mat6.get_cols() << std::endl;
+    std::cout << "Number of panels in matrix 6: " << mat6.get_num_panels() << std::endl;
+
+    auto start5 = std::chrono::high_resolution_clock::now();
+    auto result5 = mat6 * vec;
+    auto end5 = std::chrono::high_resolution_clock::now();
+    auto duration5 = std::chrono::duration_cast<std::chrono::microseconds>(end5 - start5);
+
+    double max_diff5 = 0;
+    for (std::size_t i = 0; i < result5.size(); ++i){
+        max_diff5 = std::max(max_diff5, std::abs(result5[i] - result2[i]));
+    }
+    std::cout << "Time taken for multiplication with panel matrix: " << duration5.count() << " µs" << std::endl;
+    std::cout << "Max difference between panel and compressed results: " << max_diff5 << std::endl;
+
+    // Testing lazy expressions, y = 2*(A*x) - 0.5*z evaluated in one fused pass
+    std::vector<double> vec_z(mat3.get_rows(), 1.0);
+    std::vector<double> result6(mat3.get_rows());
+    auto start6 = std::chrono::high_resolution_clock::now();
+    assign(result6, 2.0 * (lazy(mat3) * lazy(vec)) - 0.5 * lazy(vec_z));
+    auto end6 = std::chrono::high_resolution_clock::now();
+    auto duration6 = std::chrono::duration_cast<std::chrono::microseconds>(end6 - start6);
+
+    double max_diff6 = 0;
+    for (std::size_t i = 0; i < result6.size(); ++i){
+        max_diff6 = std::max(max_diff6, std::abs(result6[i] - (2.0 * result2[i] - 0.5 * vec_z[i])));
+    }
+    std::cout << "Time taken for fused expression with compressed row matrix: " << duration6.count() << " µs" << std::endl;
+    std::cout << "Max difference between fused and eager results: " << max_diff6 << std::endl;
+
+    // Testing element-wise operations on compressed matrices
+    auto start7 = std::chrono::high_resolution_clock::now();
+    auto mat7 = axpby(2.0, mat3, -1.0, mat3);  // merge of the two matrices
+    auto end7 = std::chrono::high_resolution_clock::now();
+    auto duration7 = std::chrono::duration_cast<std::chrono::microseconds>(end7 - start7);
+
+    auto start8 = std::chrono::high_resolution_clock::now();
+    axpby_inplace(2.0, mat7, -1.0, mat3);  // same sparsity pattern, updated in place
+    auto end8 = std::chrono::high_resolution_clock::now();
+    auto duration8 = std::chrono::duration_cast<std::chrono::microseconds>(end8 - start8);
+
+    std::cout << "Time taken for merged 2*A - A: " << duration7.count() << " µs" << std::endl;
+    std::cout << "Time taken for in-place 2*(2*A - A) - A: " << duration8.count() << " µs" << std::endl;
+    std::cout << "Frobenius norm of (2*(2*A - A) - A) - A: " << (mat7 - mat3).norm<NormType::Frobenius>() << std::endl;
+    std::cout << "Non-zero elements of A ∘ A: " << hadamard(mat3, mat3).get_nnz() << std::endl;
+
+    // Testing snapshots, readers multiply while a writer publishes new versions
+    snapshot_handle<double, StorageOrder::row_major> handle(mat3);
+    std::atomic<bool> writer_done{false};
+    std::atomic<std::size_t> num_reads{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; ++t){
+        readers.emplace_back([&]{
+            snapshot_reader<double, StorageOrder::row_major> reader(handle);
+            while (!writer_done){
+                const auto& snap = reader.acquire();
+                auto res = snap * vec;  // each version is a multiple of mat3
+                if (std::abs(res[0] - snap.get_version() * result2[0]) > 1e-9 * std::abs(res[0])){
+                    std::cout << "Inconsistent snapshot read" << std::endl;
+                }
+                num_reads++;
+            }
+        });
+    }
+    for (int v = 2; v <= 5; ++v){
+        handle.publish(scale(static_cast<double>(v), mat3));  // rebuilt off to the side
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    writer_done = true;
+    for (auto& reader : readers){
+        reader.join();
+    }
+    std::cout << "Snapshot version after rebuilds: " << handle.get_version() << std::endl;
+    std::cout << "Concurrent reads during rebuilds: " << (num_reads > 0 ? "yes" : "no") << std::endl;
+
+    // Testing the batching executor, independent requests are multiplied together
+    {
+        executor_config config;
+        config.max_batch = 8;
+        config.max_latency = std::chrono::microseconds(200);
+        spmv_executor<double, StorageOrder::row_major> executor(mat3, config);
+        std::vector<std::future<std::vector<double>>> futures;
+        for (int r = 0; r < 32; ++r){
+            futures.push_back(executor.submit(vec));
+        }
+        double max_diff9 = 0;
+        for (auto& future : futures){
+            auto res = future.get();
+            for (std::size_t i = 0; i < res.size(); ++i){
+                max_diff9 = std::max(max_diff9, std::abs(res[i] - result2[i]));
+            }
+        }
+        executor_stats stats = executor.get_stats();
+        std::cout << "Executor requests: " << stats.requests << ", batches: " << stats.batches
+                  << ", mean batch size: " << stats.mean_batch_size << std::endl;
+        std::cout << "Executor mean latency: " << stats.mean_latency_us << " µs, max latency: " << stats.max_latency_us
+                  << " µs, throughput: " << stats.throughput << " requests/s" << std::endl;
+        std::cout << "Max difference between batched and single results: " << max_diff9 << std::endl;
+    }
+
+    // Benchmark of NUMA-aware placement against naive placement on a larger banded matrix
+    {
+        std::size_t n = 200000;
+        std::size_t band = 16;
+        std::vector<std::size_t> outer(n + 1);
+        std::vector<std::size_t> inner(n * band);
+        std::vector<double> vals(n * band, 1.0);
+        for (std::size_t i = 0; i < n; ++i){
+            outer[i + 1] = (i + 1) * band;
+            for (std::size_t k = 0; k < band; ++k){
+                inner[i * band + k] = (i + k * 97) % n;
+            }
+            std::sort(inner.begin() + i * band, inner.begin() + (i + 1) * band);
+        }
+        matrix<double, StorageOrder::row_major> mat8;
+        mat8.set_compressed(n, n, std::move(outer), std::move(inner), std::move(vals));
+        std::vector<double> ones(n, 1.0);
+
+        // Average time of one multiplication in µs, threads are pinned in both runs so only the placement differs
+        auto bench = [&](std::size_t threads, Placement placement){
+            pinned_team team(threads);
+            numa_matrix<double> numa_mat(mat8, team, placement);
+            auto x = numa_mat.make_input(ones);
+            auto y = numa_mat.make_output();
+            numa_mat.multiply(x, y);  // warm up
+            int reps = 20;
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int r = 0; r < reps; ++r){
+                numa_mat.multiply(x, y);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            return std::chrono::duration<double, std::micro>(end - start).count() / reps;
+        };
+
+        std::size_t max_threads = numa_cpu_order().size();
+        double naive_single = 0;
+        for (std::size_t threads = 1; ; threads = std::min(2 * threads, max_threads)){
+            double naive = bench(threads, Placement::naive);
+            double aware = bench(threads, Placement::numa_aware);
+            if (threads == 1){
+                naive_single = naive;
+            }
+            std::cout << "Threads: " << threads << ", naive placement: " << naive << " µs, NUMA-aware placement: " << aware
+                      << " µs, gain: " << naive / aware << "x, scaling over 1 thread: " << naive_single / aware << "x" << std::endl;
+            if (threads == max_threads){
+                break;
+            }
+        }
+    }
+
+    // Testing matrix powers kernel against repeated multiplications
+    {
+        std::size_t s = 4;
+        auto basis = matrix_powers(mat3, vec, s);
+        std::vector<double> power = vec;
+        double max_rel_diff = 0;
+        for (std::size_t k = 1; k <= s; ++k){
+            power = mat3 * power;
+            for (std::size_t i = 0; i < power.size(); ++i){
+                max_rel_diff = std::max(max_rel_diff, std::abs(basis(i, k) - power[i]) / (1 + std::abs(power[i])));
+            }
+        }
+        std::cout << "Max relative difference between matrix powers and repeated products: " << max_rel_diff << std::endl;
+
+        // Benchmark on a banded matrix, where ghost regions stay small
+        std::size_t n = 500000;
+        std::vector<std::size_t> outer(n + 1, 0);
+        std::vector<std::size_t> inner;
+        std::vector<double> vals;
+        for (std::size_t i = 0; i < n; ++i){
+            for (std::size_t j = (i < 2 ? 0 : i - 2); j <= std::min(n - 1, i + 2); ++j){
+                inner.push_back(j);
+                vals.push_back(0.2);
+            }
+            outer[i + 1] = inner.size();
+        }
+        matrix<double, StorageOrder::row_major> mat9;
+        mat9.set_compressed(n, n, std::move(outer), std::move(inner), std::move(vals));
+        std::vector<double> ones(n, 1.0);
+
+        // Best time over a few runs in µs
+        auto best_time = [](auto func){
+            double best = 0;
+            for (int r = 0; r < 5; ++r){
+                auto start = std::chrono::high_resolution_clock::now();
+                func();
+                auto end = std::chrono::high_resolution_clock::now();
+                double time = std::chrono::duration<double, std::micro>(end - start).count();
+                best = (r == 0) ? time : std::min(best, time);
+            }
+            return best;
+        };
+
+        double time10 = best_time([&]{
+            std::vector<std::vector<double>> powers{ones};
+            for (std::size_t k = 1; k <= s; ++k){
+                powers.push_back(mat9 * powers.back());
+            }
+        });
+
+        // The plan is built once and applied to every vector
+        auto start11 = std::chrono::high_resolution_clock::now();
+        powers_plan<double> plan(mat9, s);
+        auto end11 = std::chrono::high_resolution_clock::now();
+        auto duration11 = std::chrono::duration_cast<std::chrono::microseconds>(end11 - start11);
+
+        double time12 = best_time([&]{
+            auto basis9 = plan.apply(mat9, ones);
+        });
+
+        // Bytes moved by s plain sweeps: row offsets, column indices, values, input and output vectors
+        std::size_t sweep_bytes = s * ((n + 1) * sizeof(std::size_t) + mat9.get_nnz() * (sizeof(std::size_t) + sizeof(double)) + 2 * n * sizeof(double));
+        std::cout << "Matrix powers plan: " << plan.get_num_blocks() << " blocks, ghost fraction: " << plan.get_ghost_fraction()
+                  << ", built in " << duration11.count() << " µs" << std::endl;
+        std::cout << "Time taken for " << s << " repeated multiplications: " << time10 << " µs, estimated traffic: "
+                  << sweep_bytes / 1000000.0 << " MB" << std::endl;
+        std::cout << "Time taken for matrix powers kernel with s = " << s << ": " << time12 << " µs, estimated traffic: "
+                  << plan.get_traffic_bytes() / 1000000.0 << " MB" << std::endl;
+
+        // Scattered matrix, the ghost regions cover most rows and plain sweeps are used
+        std::size_t n2 = 20000;
+        std::vector<std::size_t> outer2(n2 + 1, 0);
+        std::vector<std::size_t> inner2;
+        for (std::size_t i = 0; i < n2; ++i){
+            std::size_t far = (i * 7919) % n2;
+            inner2.push_back(std::min(i, far));
+            if (far != i){
+                inner2.push_back(std::max(i, far));
+            }
+            outer2[i + 1] = inner2.size();
+        }
+        std::vector<double> vals2(inner2.size(), 0.5);
+        matrix<double, StorageOrder::row_major> mat10;
+        mat10.set_compressed(n2, n2, std::move(outer2), std::move(inner2), std::move(vals2));
+        powers_plan<double> scattered_plan(mat10, s, 1 << 12);
+        std::cout << "Plain sweeps used for scattered matrix: " << (scattered_plan.uses_fallback() ? "yes" : "no") << std::endl;
+    }
+
     // Testing transpose_view
     matrix<double, StorageOrder::row_major> mat5(3, 3);
     mat5(0, 0) = 1;